@@ -0,0 +1,48 @@
+#include "arena.h"
+
+#include <cstdint>
+#include <utility>
+
+using namespace std;
+
+namespace runtime {
+
+    namespace {
+        thread_local shared_ptr<Arena> current_arena;
+    }  // namespace
+
+    void* Arena::Allocate(size_t size, size_t align) {
+        auto aligned = [align](char* p) {
+            return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + align - 1) & ~(align - 1));
+        };
+        used_ += size;
+        if (size > CHUNK_SIZE / 4) { // would waste much of a regular chunk --own chunk, current one stays open
+            // new[] memory is aligned to max_align_t, so a dedicated chunk needs no padding
+            auto& chunk = chunks_.emplace_back(make_unique<char[]>(size));
+            return chunk.get();
+        }
+        char* p = pos_ != nullptr ? aligned(pos_) : nullptr;
+        if (p == nullptr || p + size > end_) {
+            auto& chunk = chunks_.emplace_back(make_unique<char[]>(CHUNK_SIZE));
+            p = chunk.get();
+            end_ = p + CHUNK_SIZE;
+        }
+        pos_ = p + size;
+        return p;
+    }
+
+    size_t Arena::BytesUsed() const {
+        return used_;
+    }
+
+    Arena::Scope::Scope(std::shared_ptr<Arena> arena): previous_(exchange(current_arena, std::move(arena))) {}
+
+    Arena::Scope::~Scope() {
+        current_arena = std::move(previous_);
+    }
+
+    const std::shared_ptr<Arena>& Arena::Current() {
+        return current_arena;
+    }
+
+}  // namespace runtime
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace runtime {
+
+    // Bump allocator for syntax tree nodes --memory is released all at once when the arena is destroyed,
+    // single nodes are never freed
+    class Arena {
+    public:
+        Arena() = default;
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        // Returns size bytes aligned to align, which must be a power of two not above alignof(std::max_align_t)
+        void* Allocate(size_t size, size_t align);
+
+        // Bytes handed out so far, without chunk tails left unused
+        [[nodiscard]] size_t BytesUsed() const;
+
+        // Makes arena the current one of this thread until the scope ends --Executable nodes created meanwhile are
+        // placed in it. Scopes nest, the previous arena becomes current again
+        class Scope {
+        public:
+            explicit Scope(std::shared_ptr<Arena> arena);
+            ~Scope();
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            std::shared_ptr<Arena> previous_;
+        };
+
+        // Arena of the innermost scope on this thread, nullptr outside scopes
+        static const std::shared_ptr<Arena>& Current();
+
+    private:
+        static constexpr size_t CHUNK_SIZE = 64 << 10; // larger allocations get a chunk of their own
+
+        std::vector<std::unique_ptr<char[]>> chunks_;
+        char* pos_ = nullptr; // free space of the last regular chunk
+        char* end_ = nullptr;
+        size_t used_ = 0;
+    };
+
+}  // namespace runtime
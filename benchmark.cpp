@@ -0,0 +1,279 @@
+#include "lexer.h"
+#include "parse.h"
+#include "token_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Every heap allocation of the process is counted --tokens own no memory, so allocations per token show what the
+// symbol table, string pools and syntax tree cost
+namespace {
+    atomic<size_t> allocations{0};
+}
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+namespace {
+
+    // Program generators --each appends top-level statements until the program reaches size bytes
+    // Every generated program is valid Mython, so the parser runs to the end
+
+    string GenerateDeepNesting(size_t size) {
+        constexpr int depth = 24;
+        string program;
+        for (int i = 0; program.size() < size; ++i) {
+            program += "class Deep"s + to_string(i) + ":\n  def run(x):\n"s;
+            string indent = "    "s;
+            for (int level = 0; level < depth; ++level) {
+                program += indent + "if x > "s + to_string(level) + ":\n"s;
+                indent += "  "s;
+            }
+            program += indent + "x = x + 1\n    return x\n\n"s;
+        }
+        return program;
+    }
+
+    string GenerateManyClasses(size_t size) {
+        string program = "class Base0:\n  def __init__():\n    self.value = 0\n\n"s;
+        for (int i = 1; program.size() < size; ++i) {
+            string name = "Class"s + to_string(i);
+            string base = i == 1 ? "Base0"s : "Class"s + to_string(i - 1);
+            program += "class "s + name + "("s + base + "):\n"s
+                       + "  def __init__(a, b):\n    self.a = a\n    self.b = b\n\n"s
+                       + "  def get(other):\n    return self.a + other.b\n\n"s
+                       + "  def __str__():\n    return 'c' + str(self.a)\n\n"s
+                       + "obj"s + to_string(i) + " = "s + name + "(1, 2)\n"s;
+        }
+        return program;
+    }
+
+    string GenerateLongExpressions(size_t size) {
+        constexpr int terms = 200;
+        string program;
+        for (int i = 0; program.size() < size; ++i) {
+            string line = "value"s + to_string(i) + " = 1"s;
+            for (int term = 0; term < terms; ++term) {
+                static const char* const operations[] = {" + ", " - ", " * ", " / "};
+                line += operations[term % 4];
+                line += term % 7 == 0 ? "(x"s + to_string(term) + " + 3)"s : to_string(term + 1);
+            }
+            program += line + "\nflag"s + to_string(i) + " = a < b and not c >= d or e == f and g != h\n"s;
+        }
+        return program;
+    }
+
+    string GenerateCommentHeavy(size_t size) {
+        string program;
+        for (int i = 0; program.size() < size; ++i) {
+            program += "# Section "s + to_string(i) + ": explanation of what the next statement is for\n"s
+                       + "#    indented comment with 'quotes' and \"more quotes\" that are not strings\n\n"s
+                       + "x"s + to_string(i) + " = "s + to_string(i) + " # trailing comment\n"s
+                       + "        # comment at another indent\n"s;
+        }
+        return program;
+    }
+
+    string GenerateStringHeavy(size_t size) {
+        string program;
+        for (int i = 0; program.size() < size; ++i) {
+            program += "s"s + to_string(i) + " = 'a fairly long string literal number "s + to_string(i)
+                       + " with some words in it' + \"and another one with escapes\\t\\n and \\\"quotes\\\"\"\n"s
+                       + "print s"s + to_string(i) + ", 'short', \"\"\n"s;
+        }
+        return program;
+    }
+
+    // Identifiers and keywords only --many names share the first char and length of a keyword,
+    // so keyword recognition can't decide by those alone
+    string GenerateIdentifierHeavy(size_t size) {
+        string program = "class Base:\n  def base():\n    return None\n\n"s;
+        for (int i = 0; program.size() < size; ++i) {
+            string n = to_string(i);
+            program += "class Names"s + n + "(Base):\n"s
+                       + "  def define(classy, iffy, orbit):\n"s
+                       + "    returned = classy.printer and not iffy.notes or orbit.anders\n"s
+                       + "    if returned and Nonesuch or Trueish and not Falsey:\n"s
+                       + "      printer = elsewhere.defaults or returned.value_"s + n + "\n"s
+                       + "    else:\n"s
+                       + "      print self.field, classy, iffy, orbit, None, True, False\n"s
+                       + "    return self.result_"s + n + "\n\n"s;
+        }
+        return program;
+    }
+
+    struct Shape {
+        string_view name;
+        function<string(size_t)> generate;
+    };
+
+    const vector<Shape>& Shapes() {
+        static const vector<Shape> shapes{
+                {"deep_nesting"sv, GenerateDeepNesting},
+                {"many_classes"sv, GenerateManyClasses},
+                {"long_expressions"sv, GenerateLongExpressions},
+                {"comment_heavy"sv, GenerateCommentHeavy},
+                {"string_heavy"sv, GenerateStringHeavy},
+                {"identifier_heavy"sv, GenerateIdentifierHeavy},
+        };
+        return shapes;
+    }
+
+    struct Measurement {
+        double seconds = 0; // fastest run
+        size_t cold_allocations = 0; // first run --names new to the process are interned then
+        size_t warm_allocations = 0; // last run, the symbol table already holds every name
+    };
+
+    // Returns the fastest of repeat runs and allocation counts of the first and the last one
+    // Allocations aren't taken from the fastest run: a later run finds its names interned and would hide their cost
+    Measurement Measure(int repeat, const function<void()>& run) {
+        Measurement result;
+        for (int i = 0; i < repeat; ++i) {
+            size_t allocations_before = allocations.load(memory_order_relaxed);
+            auto start = chrono::steady_clock::now();
+            run();
+            chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+            result.warm_allocations = allocations.load(memory_order_relaxed) - allocations_before;
+            if (i == 0) {
+                result.cold_allocations = result.warm_allocations;
+            }
+            if (i == 0 || elapsed.count() < result.seconds) {
+                result.seconds = elapsed.count();
+            }
+        }
+        return result;
+    }
+
+    size_t CountTokens(parse::TokenStream& tokens) {
+        size_t count = 1;
+        while (!tokens.CurrentToken().Is<parse::token_type::Eof>()) {
+            tokens.NextToken();
+            ++count;
+        }
+        return count;
+    }
+
+    struct Options {
+        size_t size = 4 << 20;
+        int repeat = 5;
+        vector<string> shapes;
+        string output;
+    };
+
+    // Usage: mython-benchmark [--size bytes] [--repeat n] [--shape name]... [--output file]
+    Options ParseOptions(int argc, char* argv[]) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            string_view arg = argv[i];
+            if (i + 1 == argc) {
+                throw invalid_argument("ParseOptions(): no value for "s + string(arg));
+            }
+            if (arg == "--size"sv) {
+                options.size = stoul(argv[++i]);
+            } else if (arg == "--repeat"sv) {
+                options.repeat = max(stoi(argv[++i]), 1);
+            } else if (arg == "--shape"sv) {
+                options.shapes.emplace_back(argv[++i]);
+            } else if (arg == "--output"sv) {
+                options.output = argv[++i];
+            } else {
+                throw invalid_argument("ParseOptions(): unknown option "s + string(arg));
+            }
+        }
+        return options;
+    }
+
+    // Writes one JSON object per shape and phase
+    void WriteResult(ostream& out, bool first, string_view shape, string_view phase, size_t bytes, size_t tokens,
+                     const Measurement& m) {
+        out << (first ? "\n    "sv : ",\n    "sv) << R"({"shape": ")" << shape << R"(", "phase": ")" << phase
+            << R"(", "bytes": )" << bytes << R"(, "tokens": )" << tokens << R"(, "seconds": )" << m.seconds
+            << R"(, "tokens_per_sec": )" << static_cast<double>(tokens) / m.seconds
+            << R"(, "mb_per_sec": )" << static_cast<double>(bytes) / (1 << 20) / m.seconds
+            << R"(, "allocs_per_token": )" << static_cast<double>(m.cold_allocations) / static_cast<double>(tokens)
+            << R"(, "warm_allocs_per_token": )" << static_cast<double>(m.warm_allocations) / static_cast<double>(tokens)
+            << '}';
+    }
+
+    void RunBenchmarks(const Options& options, ostream& out) {
+        out << R"({"size": )" << options.size << R"(, "repeat": )" << options.repeat << R"(, "results": [)";
+        bool first = true;
+        for (const Shape& shape : Shapes()) {
+            if (!options.shapes.empty()
+                && find(options.shapes.begin(), options.shapes.end(), shape.name) == options.shapes.end()) {
+                continue;
+            }
+            const string program = shape.generate(options.size);
+            size_t tokens = 0;
+
+            // Lexer alone: scan every token of the program
+            Measurement lexer = Measure(options.repeat, [&] {
+                parse::Lexer lexer{string_view(program)};
+                tokens = CountTokens(lexer);
+            });
+            WriteResult(out, first, shape.name, "lexer"sv, program.size(), tokens, lexer);
+            first = false;
+
+            // Front end end to end: lexer feeding the parser
+            Measurement parse = Measure(options.repeat, [&] {
+                parse::Lexer lexer{string_view(program)};
+                auto tree = ParseProgram(lexer);
+            });
+            WriteResult(out, false, shape.name, "parse"sv, program.size(), tokens, parse);
+
+            // Parser alone: tokens replayed from a token cache in memory
+            ostringstream cache_stream;
+            parse::WriteTokenCache(program, cache_stream);
+            const string cache = cache_stream.str();
+            Measurement replay = Measure(options.repeat, [&] {
+                parse::TokenStreamLexer lexer{string_view(cache)};
+                auto tree = ParseProgram(lexer);
+            });
+            WriteResult(out, false, shape.name, "parse_replay"sv, program.size(), tokens, replay);
+        }
+        out << "\n]}\n";
+    }
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = ParseOptions(argc, argv);
+        if (options.output.empty()) {
+            RunBenchmarks(options, cout);
+        } else {
+            ofstream out(options.output);
+            RunBenchmarks(options, out);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,636 @@
+#include "flat_program.h"
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+using namespace std;
+
+namespace ast {
+
+    using runtime::Closure;
+    using runtime::Context;
+    using runtime::ObjectHolder;
+
+    namespace {
+        const runtime::Symbol ADD_METHOD{"__add__"};
+        const runtime::Symbol INIT_METHOD{"__init__"};
+        const runtime::Symbol SELF_NAME{"self"};
+
+        // Both operands as numbers, a pair of nullptrs if either isn't a number
+        pair<const runtime::Number*, const runtime::Number*> Numbers(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+            const auto* l = lhs.TryAs<runtime::Number>();
+            const auto* r = rhs.TryAs<runtime::Number>();
+            return l != nullptr && r != nullptr ? pair{l, r} : pair<const runtime::Number*, const runtime::Number*>{};
+        }
+    }  // namespace
+
+    // State of one evaluation --a method running recursively gets a frame per call
+    struct FlatProgram::Frame {
+        Frame(Closure& closure, Context& context, size_t slot_count)
+                : closure(closure), context(context), slots(slot_count) {
+        }
+
+        Closure& closure; // names of the slots, see StoreSlots
+        Context& context;
+        vector<optional<ObjectHolder>> slots; // nullopt until the variable is assigned
+        ObjectHolder returned;
+        bool returning = false; // set by Return, Compound stops and MethodBody takes the value
+        const ObjectHolder* arguments = nullptr; // self and arguments of the innermost InlinedCall, restored after it
+    };
+
+    // Appends nodes in pre-order: a node's index is reserved before its children are lowered
+    class FlatProgram::Builder {
+    public:
+        explicit Builder(FlatProgram& program): program_(program) {}
+
+        uint32_t Lower(unique_ptr<Statement>& slot) {
+            Statement* node = slot.get();
+            if (const auto* number = dynamic_cast<NumericConst*>(node)) {
+                return AddConst(ObjectHolder::Own(runtime::Number(number->GetValue())));
+            }
+            if (const auto* str = dynamic_cast<StringConst*>(node)) {
+                return AddConst(ObjectHolder::Own(runtime::String(str->GetValue())));
+            }
+            if (const auto* boolean = dynamic_cast<BoolConst*>(node)) {
+                return AddConst(ObjectHolder::Own(runtime::Bool(boolean->GetValue())));
+            }
+            if (dynamic_cast<None*>(node) != nullptr) {
+                return AddConst({});
+            }
+            if (const auto* variable = dynamic_cast<VariableValue*>(node)) {
+                return AddVariable(variable->GetDottedIds());
+            }
+            if (auto* assignment = dynamic_cast<Assignment*>(node)) {
+                uint32_t index = AddNode(Op::Assignment, SlotOf(assignment->GetVar()));
+                return SetChildren(index, {Lower(assignment->GetRv())});
+            }
+            if (auto* assignment = dynamic_cast<FieldAssignment*>(node)) {
+                uint32_t index = AddNode(Op::FieldAssignment, AddSymbol(assignment->GetFieldName()));
+                uint32_t object = AddVariable(assignment->GetObject().GetDottedIds());
+                return SetChildren(index, {object, Lower(assignment->GetRv())});
+            }
+            if (auto* print = dynamic_cast<Print*>(node)) {
+                uint32_t index = AddNode(Op::Print);
+                return SetChildren(index, LowerAll(print->GetArgs()));
+            }
+            if (auto* call = dynamic_cast<MethodCall*>(node)) {
+                uint32_t index = AddNode(Op::MethodCall, AddSymbol(call->GetMethod()));
+                vector<uint32_t> children{Lower(call->GetObject())};
+                for (uint32_t arg : LowerAll(call->GetArgs())) {
+                    children.push_back(arg);
+                }
+                return SetChildren(index, children);
+            }
+            if (auto* instance = dynamic_cast<NewInstance*>(node)) {
+                program_.classes_.push_back(&instance->GetClass());
+                uint32_t index = AddNode(Op::NewInstance, static_cast<uint32_t>(program_.classes_.size() - 1));
+                return SetChildren(index, LowerAll(instance->GetArgs()));
+            }
+            if (auto* stringify = dynamic_cast<Stringify*>(node)) {
+                return LowerUnary(Op::Stringify, *stringify);
+            }
+            if (auto* negation = dynamic_cast<Not*>(node)) {
+                return LowerUnary(Op::Not, *negation);
+            }
+            if (auto* negation = dynamic_cast<Negate*>(node)) {
+                return LowerUnary(Op::Negate, *negation);
+            }
+            if (auto* comparison = dynamic_cast<BuiltinComparison*>(node)) {
+                return LowerBinary(static_cast<Op>(static_cast<int>(Op::Equal) + static_cast<int>(comparison->GetOp())),
+                                   *comparison);
+            }
+            if (auto* comparison = dynamic_cast<Comparison*>(node)) {
+                program_.comparators_.push_back(comparison->GetComparator());
+                return LowerBinary(Op::Comparison, *comparison, static_cast<uint32_t>(program_.comparators_.size() - 1));
+            }
+            if (auto* add = dynamic_cast<Add*>(node)) {
+                return LowerBinary(Op::Add, *add);
+            }
+            if (auto* sub = dynamic_cast<Sub*>(node)) {
+                return LowerBinary(Op::Sub, *sub);
+            }
+            if (auto* mult = dynamic_cast<Mult*>(node)) {
+                return LowerBinary(Op::Mult, *mult);
+            }
+            if (auto* div = dynamic_cast<Div*>(node)) {
+                return LowerBinary(Op::Div, *div);
+            }
+            if (auto* disjunction = dynamic_cast<Or*>(node)) {
+                return LowerBinary(Op::Or, *disjunction);
+            }
+            if (auto* conjunction = dynamic_cast<And*>(node)) {
+                return LowerBinary(Op::And, *conjunction);
+            }
+            if (auto* compound = dynamic_cast<Compound*>(node)) {
+                uint32_t index = AddNode(Op::Compound);
+                return SetChildren(index, LowerAll(compound->GetStatements()));
+            }
+            if (auto* ret = dynamic_cast<Return*>(node)) {
+                uint32_t index = AddNode(Op::Return);
+                return SetChildren(index, {Lower(ret->GetStatement())});
+            }
+            if (auto* if_else = dynamic_cast<IfElse*>(node)) {
+                uint32_t index = AddNode(Op::IfElse);
+                vector<uint32_t> children{Lower(if_else->GetCondition()), Lower(if_else->GetIfBody())};
+                if (if_else->GetElseBody()) {
+                    children.push_back(Lower(if_else->GetElseBody()));
+                }
+                return SetChildren(index, children);
+            }
+            if (const auto* definition = dynamic_cast<ClassDefinition*>(node)) { // assigns the class to its name
+                auto& cls = *definition->GetClass().TryAs<runtime::Class>();
+                LowerMethods(cls);
+                uint32_t index = AddNode(Op::Assignment, SlotOf(runtime::Symbol(cls.GetName())));
+                return SetChildren(index, {AddConst(definition->GetClass())});
+            }
+            if (auto* inlined = dynamic_cast<InlinedCall*>(node)) {
+                MethodCall& call = inlined->GetCall();
+                program_.inlined_.push_back({&inlined->GetClass(), call.GetMethod(), inlined->ReturnsValue()});
+                uint32_t index = AddNode(Op::InlinedCall, static_cast<uint32_t>(program_.inlined_.size() - 1));
+                vector<uint32_t> children{Lower(call.GetObject())};
+                for (uint32_t arg : LowerAll(call.GetArgs())) {
+                    children.push_back(arg);
+                }
+                children.push_back(Lower(inlined->GetBody()));
+                return SetChildren(index, children);
+            }
+            if (const auto* argument = dynamic_cast<InlinedArgument*>(node)) {
+                const auto& fields = argument->GetFields();
+                uint32_t index = AddNode(Op::InlinedArgument, static_cast<uint32_t>(argument->GetIndex()));
+                program_.first_children_[index] = static_cast<uint32_t>(program_.symbols_.size());
+                program_.child_counts_[index] = static_cast<uint32_t>(fields.size());
+                program_.symbols_.insert(program_.symbols_.end(), fields.begin(), fields.end());
+                return index;
+            }
+            if (auto* assignment = dynamic_cast<InlinedFieldAssignment*>(node)) {
+                uint32_t index = AddNode(Op::FieldAssignment, AddSymbol(assignment->GetFieldName()));
+                uint32_t object = Lower(assignment->GetObject());
+                return SetChildren(index, {object, Lower(assignment->GetRv())});
+            }
+            if (auto* body = dynamic_cast<MethodBody*>(node)) {
+                uint32_t index = AddNode(Op::MethodBody);
+                return SetChildren(index, {Lower(body->GetBody())});
+            }
+            if (auto* program = dynamic_cast<Program*>(node)) {
+                return Lower(program->GetBody()); // only keeps the arena, which the FlatProgram takes over
+            }
+            program_.fallbacks_.push_back(std::move(slot));
+            return AddNode(Op::Fallback, static_cast<uint32_t>(program_.fallbacks_.size() - 1));
+        }
+
+    private:
+        uint32_t AddNode(Op op, uint32_t operand = 0) {
+            program_.ops_.push_back(op);
+            program_.operands_.push_back(operand);
+            program_.first_children_.push_back(0);
+            program_.child_counts_.push_back(0);
+            return static_cast<uint32_t>(program_.ops_.size() - 1);
+        }
+
+        uint32_t SetChildren(uint32_t index, const vector<uint32_t>& children) {
+            program_.first_children_[index] = static_cast<uint32_t>(program_.children_.size());
+            program_.child_counts_[index] = static_cast<uint32_t>(children.size());
+            program_.children_.insert(program_.children_.end(), children.begin(), children.end());
+            return index;
+        }
+
+        uint32_t AddSymbol(runtime::Symbol symbol) {
+            program_.symbols_.push_back(symbol);
+            return static_cast<uint32_t>(program_.symbols_.size() - 1);
+        }
+
+        uint32_t AddConst(ObjectHolder value) {
+            program_.constants_.push_back(std::move(value));
+            return AddNode(Op::Const, static_cast<uint32_t>(program_.constants_.size() - 1));
+        }
+
+        // Slot of a variable, the first use of a name takes the next free one
+        uint32_t SlotOf(runtime::Symbol name) {
+            auto [it, inserted] = slots_.try_emplace(name, static_cast<uint32_t>(program_.slot_names_.size()));
+            if (inserted) {
+                program_.slot_names_.push_back(name);
+            }
+            return it->second;
+        }
+
+        // The first id is a variable, the others are fields stored in symbols_ --the node's children range points at them
+        uint32_t AddVariable(const vector<runtime::Symbol>& dotted_ids) {
+            uint32_t index = AddNode(Op::Variable, SlotOf(dotted_ids.front()));
+            program_.first_children_[index] = static_cast<uint32_t>(program_.symbols_.size());
+            program_.child_counts_[index] = static_cast<uint32_t>(dotted_ids.size() - 1);
+            program_.symbols_.insert(program_.symbols_.end(), dotted_ids.begin() + 1, dotted_ids.end());
+            return index;
+        }
+
+        vector<uint32_t> LowerAll(vector<unique_ptr<Statement>>& nodes) {
+            vector<uint32_t> result;
+            result.reserve(nodes.size());
+            for (auto& node : nodes) {
+                result.push_back(Lower(node));
+            }
+            return result;
+        }
+
+        uint32_t LowerUnary(Op op, UnaryOperation& node) {
+            uint32_t index = AddNode(op);
+            return SetChildren(index, {Lower(node.GetArgument())});
+        }
+
+        uint32_t LowerBinary(Op op, BinaryOperation& node, uint32_t operand = 0) {
+            uint32_t index = AddNode(op, operand);
+            uint32_t lhs = Lower(node.GetLhs());
+            return SetChildren(index, {lhs, Lower(node.GetRhs())});
+        }
+
+        // Method bodies run through Class, so they are lowered where the class is defined
+        static void LowerMethods(runtime::Class& cls) {
+            for (runtime::Method& method : cls.GetOwnMethods()) {
+                if (dynamic_cast<MethodBody*>(method.body.get()) != nullptr) { // not lowered yet
+                    vector<runtime::Symbol> params{SELF_NAME};
+                    params.insert(params.end(), method.formal_params.begin(), method.formal_params.end());
+                    method.body = Build(std::move(method.body), params);
+                }
+            }
+        }
+
+    public:
+        // Lowers tree with params bound to the first slots in their order
+        static unique_ptr<FlatProgram> Build(unique_ptr<Statement> tree, const vector<runtime::Symbol>& params) {
+            auto program = make_unique<FlatProgram>();
+            if (auto* root = dynamic_cast<Program*>(tree.get())) {
+                program->arena_ = root->GetArena();
+            } else if (auto* body = dynamic_cast<MethodBody*>(tree.get())) {
+                program->arena_ = body->GetArena();
+            }
+            Builder builder(*program);
+            for (runtime::Symbol param : params) {
+                builder.SlotOf(param);
+            }
+            program->param_slots_ = static_cast<uint32_t>(program->slot_names_.size());
+            program->root_ = builder.Lower(tree);
+            return program;
+        }
+
+    private:
+        FlatProgram& program_;
+        unordered_map<runtime::Symbol, uint32_t> slots_;
+    };
+
+    size_t FlatProgram::Size() const {
+        return ops_.size();
+    }
+
+    ObjectHolder FlatProgram::Execute(Closure& closure, Context& context) {
+        Frame frame(closure, context, slot_names_.size());
+        LoadSlots(frame);
+        try {
+            ObjectHolder result = Run(frame);
+            StoreSlots(frame);
+            return result;
+        } catch (...) { // variables assigned before the error stay visible, as with the tree
+            StoreSlots(frame);
+            throw;
+        }
+    }
+
+    ObjectHolder FlatProgram::ExecuteMethod(const runtime::Method& method, const ObjectHolder& self,
+                                            const vector<ObjectHolder>& actual_args, Context& context) {
+        if (param_slots_ != actual_args.size() + 1) { // not lowered as the body of this method
+            return Statement::ExecuteMethod(method, self, actual_args, context);
+        }
+        Closure closure; // stays empty unless a fallback node needs names
+        Frame frame(closure, context, slot_names_.size());
+        frame.slots[0] = self;
+        for (size_t i = 0; i < actual_args.size(); ++i) {
+            frame.slots[i + 1] = actual_args[i];
+        }
+        return Run(frame);
+    }
+
+    ObjectHolder FlatProgram::Run(Frame& frame) {
+        ObjectHolder result = Eval(root_, frame);
+        if (frame.returning) { // return outside of a method leaves the program like the tree's Return does
+            throw frame.returned;
+        }
+        return result;
+    }
+
+    void FlatProgram::LoadSlots(Frame& frame) const {
+        for (size_t slot = 0; slot < slot_names_.size(); ++slot) {
+            if (auto it = frame.closure.find(slot_names_[slot]); it != frame.closure.end()) {
+                frame.slots[slot] = it->second;
+            }
+        }
+    }
+
+    void FlatProgram::StoreSlots(Frame& frame) const {
+        for (size_t slot = 0; slot < slot_names_.size(); ++slot) {
+            if (frame.slots[slot]) {
+                frame.closure[slot_names_[slot]] = *frame.slots[slot];
+            }
+        }
+    }
+
+    // Follows the original lookup of dotted ids: a name is searched where the previous one ended, the fields of
+    // an object or, after anything else, the variables still
+    const ObjectHolder& FlatProgram::EvalVariable(uint32_t node, Frame& frame) const {
+        auto local = [this, &frame](runtime::Symbol name) -> const ObjectHolder& {
+            auto slot = static_cast<size_t>(find(slot_names_.begin(), slot_names_.end(), name) - slot_names_.begin());
+            if (slot == slot_names_.size() || !frame.slots[slot]) {
+                throw runtime_error("FlatProgram::Eval(): unknown name "s + string(name.Name()));
+            }
+            return *frame.slots[slot];
+        };
+        const optional<ObjectHolder>& first = frame.slots[operands_[node]];
+        const ObjectHolder* value = first ? &*first : &local(slot_names_[operands_[node]]); // throws
+        const runtime::Symbol* ids = symbols_.data() + first_children_[node];
+        Closure* fields = nullptr;
+        for (uint32_t i = 0; i < child_counts_[node]; ++i) {
+            if (auto* instance = value->TryAs<runtime::ClassInstance>()) {
+                fields = &instance->Fields();
+            }
+            if (fields == nullptr) {
+                value = &local(ids[i]);
+                continue;
+            }
+            auto it = fields->find(ids[i]);
+            if (it == fields->end()) {
+                throw runtime_error("FlatProgram::Eval(): unknown name "s + string(ids[i].Name()));
+            }
+            value = &it->second;
+        }
+        return *value;
+    }
+
+    // Same steps as InlinedCall::Execute: arguments, then the object, then the guard on its class
+    ObjectHolder FlatProgram::EvalInlinedCall(uint32_t node, Frame& frame) {
+        const Inlined& inlined = inlined_[operands_[node]];
+        const uint32_t arg_count = child_counts_[node] - 2;
+        array<ObjectHolder, InlinedCall::MAX_PARAMS + 1> arguments;
+        for (uint32_t i = 0; i < arg_count; ++i) {
+            arguments[i + 1] = EvalChild(node, i + 1, frame);
+        }
+        arguments[0] = EvalChild(node, 0, frame);
+        auto* instance = arguments[0].TryAs<runtime::ClassInstance>();
+        if (instance == nullptr) {
+            throw runtime_error("FlatProgram::Eval(): method "s + string(inlined.method.Name())
+                                + " called on a non-object"s);
+        }
+        if (&instance->GetClass() != inlined.cls) {
+            return instance->Call(inlined.method, {arguments.begin() + 1, arguments.begin() + 1 + arg_count},
+                                  frame.context);
+        }
+        const ObjectHolder* previous = std::exchange(frame.arguments, arguments.data());
+        ObjectHolder result;
+        try {
+            result = EvalChild(node, arg_count + 1, frame);
+        } catch (...) {
+            frame.arguments = previous;
+            throw;
+        }
+        frame.arguments = previous;
+        return inlined.returns_value ? result : ObjectHolder{};
+    }
+
+    const ObjectHolder& FlatProgram::EvalInlinedArgument(uint32_t node, const Frame& frame) const {
+        const ObjectHolder* value = &frame.arguments[operands_[node]];
+        const runtime::Symbol* fields = symbols_.data() + first_children_[node];
+        for (uint32_t i = 0; i < child_counts_[node]; ++i) {
+            auto* instance = value->TryAs<runtime::ClassInstance>();
+            if (instance == nullptr) {
+                throw runtime_error("FlatProgram::Eval(): field of a non-object"s);
+            }
+            auto it = instance->Fields().find(fields[i]);
+            if (it == instance->Fields().end()) {
+                throw runtime_error("FlatProgram::Eval(): unknown name "s + string(fields[i].Name()));
+            }
+            value = &it->second;
+        }
+        return *value;
+    }
+
+    ObjectHolder FlatProgram::EvalChild(uint32_t node, uint32_t child, Frame& frame) {
+        return Eval(children_[first_children_[node] + child], frame);
+    }
+
+    template <runtime::CompareOp op>
+    ObjectHolder FlatProgram::EvalComparison(uint32_t node, Frame& frame) {
+        ObjectHolder lhs = EvalChild(node, 0, frame);
+        ObjectHolder rhs = EvalChild(node, 1, frame);
+        return ObjectHolder::Own(runtime::Bool(runtime::Compare<op>(lhs, rhs, frame.context)));
+    }
+
+    ObjectHolder FlatProgram::Eval(uint32_t node, Frame& frame) {
+        const uint32_t operand = operands_[node];
+        const uint32_t count = child_counts_[node];
+        switch (ops_[node]) {
+            case Op::Const:
+                return constants_[operand];
+
+            case Op::Variable:
+                return EvalVariable(node, frame);
+
+            case Op::Assignment: {
+                ObjectHolder value = EvalChild(node, 0, frame);
+                return *(frame.slots[operand] = std::move(value));
+            }
+
+            case Op::FieldAssignment: {
+                ObjectHolder value = EvalChild(node, 1, frame); // value first, like the tree's assignment
+                auto* instance = EvalChild(node, 0, frame).TryAs<runtime::ClassInstance>();
+                if (instance == nullptr) {
+                    throw runtime_error("FlatProgram::Eval(): field assignment to a non-object"s);
+                }
+                return instance->Fields()[symbols_[operand]] = std::move(value);
+            }
+
+            case Op::Print: {
+                auto& output = frame.context.GetOutputStream();
+                ObjectHolder value;
+                for (uint32_t i = 0; i < count; ++i) {
+                    if (i != 0) {
+                        output << ' ';
+                    }
+                    value = EvalChild(node, i, frame);
+                    if (value) {
+                        value->Print(output, frame.context);
+                    } else {
+                        output << "None"sv;
+                    }
+                }
+                output << '\n';
+                return value;
+            }
+
+            case Op::MethodCall: {
+                vector<ObjectHolder> args;
+                args.reserve(count - 1);
+                for (uint32_t i = 1; i < count; ++i) {
+                    args.push_back(EvalChild(node, i, frame));
+                }
+                ObjectHolder object = EvalChild(node, 0, frame);
+                auto* instance = object.TryAs<runtime::ClassInstance>();
+                if (instance == nullptr) {
+                    throw runtime_error("FlatProgram::Eval(): method "s + string(symbols_[operand].Name())
+                                        + " called on a non-object"s);
+                }
+                return instance->Call(symbols_[operand], args, frame.context);
+            }
+
+            case Op::NewInstance: {
+                ObjectHolder instance = ObjectHolder::Own(runtime::ClassInstance(*classes_[operand]));
+                auto* class_instance = instance.TryAs<runtime::ClassInstance>();
+                if (class_instance->HasMethod(INIT_METHOD, count)) {
+                    vector<ObjectHolder> args;
+                    args.reserve(count);
+                    for (uint32_t i = 0; i < count; ++i) {
+                        args.push_back(EvalChild(node, i, frame));
+                    }
+                    class_instance->Call(INIT_METHOD, args, frame.context);
+                }
+                return instance;
+            }
+
+            case Op::Stringify: {
+                ObjectHolder value = EvalChild(node, 0, frame);
+                if (!value) {
+                    return ObjectHolder::Own(runtime::String{"None"s});
+                }
+                ostringstream output;
+                value->Print(output, frame.context);
+                return ObjectHolder::Own(runtime::String{output.str()});
+            }
+
+            case Op::Add: {
+                ObjectHolder lhs = EvalChild(node, 0, frame);
+                ObjectHolder rhs = EvalChild(node, 1, frame);
+                if (auto [l, r] = Numbers(lhs, rhs); l != nullptr) {
+                    return ObjectHolder::Own(runtime::Number(l->GetValue() + r->GetValue()));
+                }
+                const auto* l = lhs.TryAs<runtime::String>();
+                const auto* r = rhs.TryAs<runtime::String>();
+                if (l != nullptr && r != nullptr) {
+                    return ObjectHolder::Own(runtime::String(l->GetValue() + r->GetValue()));
+                }
+                if (auto* instance = lhs.TryAs<runtime::ClassInstance>(); instance != nullptr
+                                                                          && instance->HasMethod(ADD_METHOD, 1)) {
+                    return instance->Call(ADD_METHOD, {rhs}, frame.context);
+                }
+                throw runtime_error("FlatProgram::Eval(): unsupported operands of +"s);
+            }
+
+            case Op::Sub:
+            case Op::Mult:
+            case Op::Div: {
+                ObjectHolder lhs = EvalChild(node, 0, frame);
+                ObjectHolder rhs = EvalChild(node, 1, frame);
+                auto [l, r] = Numbers(lhs, rhs);
+                if (l == nullptr) {
+                    throw runtime_error("FlatProgram::Eval(): arithmetic on non-numbers"s);
+                }
+                if (ops_[node] == Op::Sub) {
+                    return ObjectHolder::Own(runtime::Number(l->GetValue() - r->GetValue()));
+                }
+                if (ops_[node] == Op::Mult) {
+                    return ObjectHolder::Own(runtime::Number(l->GetValue() * r->GetValue()));
+                }
+                if (r->GetValue() == 0) {
+                    throw runtime_error("FlatProgram::Eval(): division by zero"s);
+                }
+                return ObjectHolder::Own(runtime::Number(l->GetValue() / r->GetValue()));
+            }
+
+            case Op::Or:
+                return ObjectHolder::Own(runtime::Bool(runtime::IsTrue(EvalChild(node, 0, frame))
+                                                       || runtime::IsTrue(EvalChild(node, 1, frame))));
+
+            case Op::And:
+                return ObjectHolder::Own(runtime::Bool(runtime::IsTrue(EvalChild(node, 0, frame))
+                                                       && runtime::IsTrue(EvalChild(node, 1, frame))));
+
+            case Op::Not:
+                return ObjectHolder::Own(runtime::Bool(!runtime::IsTrue(EvalChild(node, 0, frame))));
+
+            case Op::Negate: {
+                ObjectHolder value = EvalChild(node, 0, frame);
+                const auto* number = value.TryAs<runtime::Number>();
+                if (number == nullptr) {
+                    throw runtime_error("FlatProgram::Eval(): arithmetic on non-numbers"s);
+                }
+                return ObjectHolder::Own(runtime::Number(-number->GetValue()));
+            }
+
+            case Op::Compound:
+                for (uint32_t i = 0; i < count && !frame.returning; ++i) {
+                    EvalChild(node, i, frame);
+                }
+                return {};
+
+            case Op::Return:
+                frame.returned = EvalChild(node, 0, frame);
+                frame.returning = true;
+                return {};
+
+            case Op::IfElse:
+                if (runtime::IsTrue(EvalChild(node, 0, frame))) {
+                    return EvalChild(node, 1, frame);
+                }
+                return count > 2 ? EvalChild(node, 2, frame) : ObjectHolder{};
+
+            case Op::Comparison: {
+                ObjectHolder lhs = EvalChild(node, 0, frame);
+                ObjectHolder rhs = EvalChild(node, 1, frame);
+                return ObjectHolder::Own(runtime::Bool(comparators_[operand](lhs, rhs, frame.context)));
+            }
+
+            case Op::Equal:
+                return EvalComparison<runtime::CompareOp::Equal>(node, frame);
+            case Op::NotEqual:
+                return EvalComparison<runtime::CompareOp::NotEqual>(node, frame);
+            case Op::Less:
+                return EvalComparison<runtime::CompareOp::Less>(node, frame);
+            case Op::Greater:
+                return EvalComparison<runtime::CompareOp::Greater>(node, frame);
+            case Op::LessOrEqual:
+                return EvalComparison<runtime::CompareOp::LessOrEqual>(node, frame);
+            case Op::GreaterOrEqual:
+                return EvalComparison<runtime::CompareOp::GreaterOrEqual>(node, frame);
+
+            case Op::MethodBody:
+                try {
+                    EvalChild(node, 0, frame);
+                } catch (ObjectHolder& returned) { // Return of a fallback node is still thrown
+                    return returned;
+                }
+                if (frame.returning) {
+                    frame.returning = false;
+                    return std::exchange(frame.returned, ObjectHolder{});
+                }
+                return {};
+
+            case Op::InlinedCall:
+                return EvalInlinedCall(node, frame);
+
+            case Op::InlinedArgument:
+                return EvalInlinedArgument(node, frame);
+
+            case Op::Fallback: { // sees and may change the variables by name
+                StoreSlots(frame);
+                ObjectHolder result = fallbacks_[operand]->Execute(frame.closure, frame.context);
+                LoadSlots(frame);
+                return result;
+            }
+        }
+        throw logic_error("FlatProgram::Eval(): unknown opcode"s);
+    }
+
+    std::unique_ptr<Statement> LowerToFlat(std::unique_ptr<Statement> tree) {
+        return FlatProgram::Builder::Build(std::move(tree), {});
+    }
+
+}  // namespace ast
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "statement.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ast {
+
+    // Syntax tree lowered into a table of nodes --structure of arrays indexed by node number
+    // Evaluation walks indices in a few contiguous arrays instead of chasing pointers between heap objects
+    // Every node type of statement.h has an opcode, any other Executable is kept as it is and run through Fallback
+    // Names are resolved while lowering: each variable of the program or of a method body gets a slot in a vector
+    // frame, self and the params of a method take the first slots
+    class FlatProgram : public Statement {
+    public:
+        enum class Op : uint8_t {
+            Const,           // operand: constants_
+            Variable,        // operand: slot of the first id, children range is the other dotted ids in symbols_
+            Assignment,      // operand: slot, children: value
+            FieldAssignment, // operand: symbols_, children: object variable, value
+            Print,           // children: arguments
+            MethodCall,      // operand: symbols_, children: object, arguments
+            NewInstance,     // operand: classes_, children: arguments
+            Stringify,
+            Add,
+            Sub,
+            Mult,
+            Div,
+            Or,
+            And,
+            Not,
+            Negate,
+            Compound,
+            Return,
+            IfElse,          // children: condition, if body, optional else body
+            Comparison,      // operand: comparators_, children: lhs, rhs
+            Equal,           // builtin comparisons, in the order of runtime::CompareOp, children: lhs, rhs
+            NotEqual,
+            Less,
+            Greater,
+            LessOrEqual,
+            GreaterOrEqual,
+            MethodBody,      // catches Return of its body
+            InlinedCall,     // operand: inlined_, children: object, arguments, body
+            InlinedArgument, // operand: index in the arguments of the InlinedCall, children range is fields in symbols_
+            Fallback,        // operand: fallbacks_
+        };
+
+        // Number of nodes, for tests and statistics
+        [[nodiscard]] size_t Size() const;
+
+        // Slots are loaded from closure by name and stored back when the program ends
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        // A lowered method body binds self and actual_args straight to their slots, no closure is filled
+        runtime::ObjectHolder ExecuteMethod(const runtime::Method& method, const runtime::ObjectHolder& self,
+                                            const std::vector<runtime::ObjectHolder>& actual_args,
+                                            runtime::Context& context) override;
+
+    private:
+        friend std::unique_ptr<Statement> LowerToFlat(std::unique_ptr<Statement> tree);
+        class Builder;
+        struct Frame;
+
+        runtime::ObjectHolder Run(Frame& frame);
+        runtime::ObjectHolder Eval(uint32_t node, Frame& frame);
+        runtime::ObjectHolder EvalChild(uint32_t node, uint32_t child, Frame& frame);
+        template <runtime::CompareOp op>
+        runtime::ObjectHolder EvalComparison(uint32_t node, Frame& frame);
+        const runtime::ObjectHolder& EvalVariable(uint32_t node, Frame& frame) const;
+        runtime::ObjectHolder EvalInlinedCall(uint32_t node, Frame& frame);
+        const runtime::ObjectHolder& EvalInlinedArgument(uint32_t node, const Frame& frame) const;
+
+        // Name-keyed view of the slots --frame.closure is in sync only after StoreSlots
+        void LoadSlots(Frame& frame) const;
+        void StoreSlots(Frame& frame) const;
+
+        std::shared_ptr<runtime::Arena> arena_; // fallback nodes may live in it, destroyed after them
+        std::vector<Op> ops_;
+        std::vector<uint32_t> operands_;
+        std::vector<uint32_t> first_children_; // range of the node's children in children_
+        std::vector<uint32_t> child_counts_;
+        std::vector<uint32_t> children_;
+
+        std::vector<runtime::ObjectHolder> constants_;
+        std::vector<runtime::Symbol> symbols_;
+        std::vector<const runtime::Class*> classes_;
+        std::vector<Comparison::Comparator> comparators_;
+        struct Inlined {
+            const runtime::Class* cls;
+            runtime::Symbol method; // called instead of the body when the object is of another class
+            bool returns_value;
+        };
+        std::vector<Inlined> inlined_;
+        std::vector<std::unique_ptr<runtime::Executable>> fallbacks_;
+        std::vector<runtime::Symbol> slot_names_;
+        uint32_t param_slots_ = 0; // self and params of the method the body was lowered for, 0 outside methods
+        uint32_t root_ = 0;
+    };
+
+    // Lowers tree into a FlatProgram --tree is consumed. Method bodies of the classes it defines are lowered too,
+    // each into a FlatProgram of its own that replaces the method's body
+    std::unique_ptr<Statement> LowerToFlat(std::unique_ptr<Statement> tree);
+
+}  // namespace ast
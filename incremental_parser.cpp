@@ -0,0 +1,134 @@
+#include "incremental_parser.h"
+
+#include "parallel_lexer.h"
+#include "parse.h"
+#include "token_cache.h"
+
+#include <unordered_map>
+
+using namespace std;
+
+namespace parse {
+
+    namespace {
+        constexpr uint64_t FNV_OFFSET = 14695981039346656037ULL;
+        constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+        // Tokens of a statement without Eof and the pool their String payloads point into
+        struct StatementTokens {
+            vector<Token> tokens;
+            shared_ptr<StringPool> strings;
+        };
+
+        StatementTokens Tokenize(string_view text) {
+            Lexer lexer(text);
+            StatementTokens result{{}, lexer.Strings()};
+            while (!lexer.CurrentToken().Is<token_type::Eof>()) {
+                result.tokens.push_back(lexer.CurrentToken());
+                lexer.NextToken();
+            }
+            return result;
+        }
+    }  // namespace
+
+    struct IncrementalParser::Statement {
+        std::string text;
+        uint64_t hash = 0;
+        uint64_t scope = 0; // hash of class definitions before the statement --tree is valid only after the same ones
+        std::shared_ptr<const StatementTokens> tokens; // shared by statements with the same text, freed with the last
+        std::unique_ptr<runtime::Executable> tree;
+        runtime::Symbol class_name; // class the statement declares, if any
+        runtime::ObjectHolder cls;
+    };
+
+    // Runs cached statements in source order
+    class IncrementalParser::Program : public runtime::Executable {
+    public:
+        explicit Program(const std::vector<std::unique_ptr<Statement>>& statements): statements_(statements) {}
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override {
+            for (const auto& statement : statements_) {
+                statement->tree->Execute(closure, context);
+            }
+            return {};
+        }
+
+    private:
+        const std::vector<std::unique_ptr<Statement>>& statements_;
+    };
+
+    IncrementalParser::IncrementalParser(): program_(make_unique<Program>(statements_)) {}
+
+    IncrementalParser::~IncrementalParser() = default;
+
+    runtime::Executable& IncrementalParser::Update(std::string_view source) {
+        stats_ = {};
+        unordered_multimap<uint64_t, unique_ptr<Statement>> cached;
+        for (auto& statement : statements_) {
+            uint64_t hash = statement->hash;
+            cached.emplace(hash, std::move(statement));
+        }
+        statements_.clear();
+
+        try {
+            runtime::Closure declared_classes;
+            uint64_t scope = FNV_OFFSET;
+            for (string_view text : SplitStatements(source)) {
+                uint64_t hash = HashSource(text);
+                unique_ptr<Statement> statement;
+                shared_ptr<const StatementTokens> tokens;
+                auto [first, last] = cached.equal_range(hash);
+                for (auto it = first; it != last; ++it) {
+                    if (it->second->text != text) {
+                        continue;
+                    }
+                    if (it->second->scope == scope) { // same text after the same classes --whole statement is reused
+                        statement = std::move(it->second);
+                        cached.erase(it);
+                        break;
+                    }
+                    tokens = it->second->tokens;
+                }
+
+                if (statement) {
+                    if (statement->cls) {
+                        declared_classes.emplace(statement->class_name, statement->cls);
+                    }
+                } else {
+                    statement = make_unique<Statement>();
+                    statement->text = string(text);
+                    statement->hash = hash;
+                    statement->scope = scope;
+                    if (!tokens) {
+                        tokens = make_shared<const StatementTokens>(Tokenize(text));
+                        ++stats_.lexed;
+                    }
+                    statement->tokens = tokens;
+                    const vector<Token>& list = tokens->tokens;
+                    TokenReplay replay(list);
+                    statement->tree = ParseProgram(replay, declared_classes);
+                    ++stats_.parsed;
+                    if (list.size() > 1 && list.front().Is<token_type::Class>()) {
+                        statement->class_name = list[1].As<token_type::Id>().value;
+                        statement->cls = declared_classes.at(statement->class_name);
+                    }
+                }
+
+                if (statement->cls) { // statements after a class definition may refer to it
+                    scope = (scope ^ hash) * FNV_PRIME;
+                }
+                statements_.push_back(std::move(statement));
+            }
+        } catch (...) {
+            statements_.clear();
+            throw;
+        }
+        stats_.statements = statements_.size();
+        return *program_;
+    }
+
+    const IncrementalParser::Stats& IncrementalParser::LastStats() const {
+        return stats_;
+    }
+
+}  // namespace parse
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "lexer.h"
+#include "runtime.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace parse {
+
+    // Front end for a program that is run again after small edits
+    // Every top-level statement is cached with its tokens and syntax tree, keyed by content hash
+    // Keys don't include line numbers, so statements moved by an edit above them are reused too
+    // A statement is parsed again only if its text changed or a class definition before it did --
+    // its tree may refer to those classes
+    class IncrementalParser {
+    public:
+        // Counters of the last Update
+        struct Stats {
+            size_t statements = 0;
+            size_t lexed = 0; // statements whose text had no cached tokens
+            size_t parsed = 0; // statements whose tree was built again
+        };
+
+        IncrementalParser();
+        ~IncrementalParser();
+
+        IncrementalParser(const IncrementalParser&) = delete;
+        IncrementalParser& operator=(const IncrementalParser&) = delete;
+
+        // Returns program for source, valid until the next Update
+        // On lexer or parse error the cache is dropped and the exception is rethrown
+        runtime::Executable& Update(std::string_view source);
+
+        [[nodiscard]] const Stats& LastStats() const;
+
+    private:
+        struct Statement;
+        class Program;
+
+        std::vector<std::unique_ptr<Statement>> statements_; // in source order
+        std::unique_ptr<Program> program_;
+        Stats stats_;
+    };
+
+}  // namespace parse
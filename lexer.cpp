@@ -1,16 +1,165 @@
 #include "lexer.h"
+#include "scan.h"
 
 #include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <new>
 
 using namespace std;
 
 namespace parse {
 
+    namespace {
+        // Character classes of the source alphabet, one bit per class
+        enum CharClass : uint16_t {
+            CHAR_DIGIT = 1 << 0,        // 0-9
+            CHAR_ID_START = 1 << 1,     // first identifier char: _ A-Z a-z
+            CHAR_ID_CONTINUE = 1 << 2,  // next identifier chars: _ A-Z a-z 0-9
+            CHAR_OPERATOR = 1 << 3,     // single char lexemes: , ( ) * / + - : ;
+            CHAR_COMPARE = 1 << 4,      // first char of comparison or assignment: = ! < >
+            CHAR_DOT = 1 << 5,          // field access
+            CHAR_WHITESPACE = 1 << 6,
+            CHAR_NEWLINE = 1 << 7,
+            CHAR_QUOTE = 1 << 8,        // string delimiter: ' "
+            CHAR_COMMENT = 1 << 9,      // #
+        };
+
+        constexpr std::array<uint16_t, 256> BuildCharClasses() {
+            std::array<uint16_t, 256> table{};
+            auto add = [&table](std::string_view chars, uint16_t char_class) {
+                for (char c : chars) {
+                    table[static_cast<unsigned char>(c)] |= char_class;
+                }
+            };
+            for (int c = '0'; c <= '9'; ++c) {
+                table[c] |= CHAR_DIGIT | CHAR_ID_CONTINUE;
+            }
+            for (int c = 'a'; c <= 'z'; ++c) {
+                table[c] |= CHAR_ID_START | CHAR_ID_CONTINUE;
+                table[c - 'a' + 'A'] |= CHAR_ID_START | CHAR_ID_CONTINUE;
+            }
+            add("_"sv, CHAR_ID_START | CHAR_ID_CONTINUE);
+            add(",()*/+-:;"sv, CHAR_OPERATOR);
+            add("=!<>"sv, CHAR_COMPARE);
+            add("."sv, CHAR_DOT);
+            add(" "sv, CHAR_WHITESPACE);
+            add("\n"sv, CHAR_NEWLINE);
+            add("'\""sv, CHAR_QUOTE);
+            add("#"sv, CHAR_COMMENT);
+            return table;
+        }
+
+        constexpr std::array<uint16_t, 256> CHAR_CLASSES = BuildCharClasses();
+
+        // Returns true if c belongs to any of char_classes --one indexed load
+        inline bool IsCharClass(char c, uint16_t char_classes) {
+            return (CHAR_CLASSES[static_cast<unsigned char>(c)] & char_classes) != 0;
+        }
+
+        // Chars that end a number lexeme, any other non-digit is a format error
+        constexpr uint16_t NUMBER_END = CHAR_WHITESPACE | CHAR_COMMENT | CHAR_NEWLINE | CHAR_OPERATOR;
+
+        // Reserved word and the function that builds its token in place
+        struct Keyword {
+            std::string_view word;
+            void (*make)(Token& token);
+        };
+
+        template <typename T>
+        constexpr Keyword MakeKeyword(std::string_view word) {
+            return {word, [](Token& token) { token.emplace<T>(); }};
+        }
+
+        constexpr std::array<Keyword, 12> KEYWORDS = {
+                MakeKeyword<token_type::Class>("class"sv), MakeKeyword<token_type::Return>("return"sv),
+                MakeKeyword<token_type::If>("if"sv), MakeKeyword<token_type::Else>("else"sv),
+                MakeKeyword<token_type::Def>("def"sv), MakeKeyword<token_type::Print>("print"sv),
+                MakeKeyword<token_type::And>("and"sv), MakeKeyword<token_type::Or>("or"sv),
+                MakeKeyword<token_type::Not>("not"sv), MakeKeyword<token_type::None>("None"sv),
+                MakeKeyword<token_type::True>("True"sv), MakeKeyword<token_type::False>("False"sv),
+        };
+
+        // Keyword perfect hash: (first char + length * multiplier) % table size
+        // Multiplier is searched at compile time, so editing KEYWORDS can't silently break the table
+        constexpr size_t KEYWORD_TABLE_SIZE = 32;
+
+        constexpr size_t KeywordHash(std::string_view word, size_t multiplier) {
+            return (static_cast<unsigned char>(word.front()) + word.size() * multiplier) % KEYWORD_TABLE_SIZE;
+        }
+
+        constexpr bool IsPerfectKeywordHash(size_t multiplier) {
+            std::array<bool, KEYWORD_TABLE_SIZE> used{};
+            for (const Keyword& keyword : KEYWORDS) {
+                size_t slot = KeywordHash(keyword.word, multiplier);
+                if (used[slot]) {
+                    return false;
+                }
+                used[slot] = true;
+            }
+            return true;
+        }
+
+        constexpr size_t FindKeywordHashMultiplier() {
+            for (size_t multiplier = 1; multiplier < 256; ++multiplier) {
+                if (IsPerfectKeywordHash(multiplier)) {
+                    return multiplier;
+                }
+            }
+            return 0;
+        }
+
+        constexpr size_t KEYWORD_HASH_MULTIPLIER = FindKeywordHashMultiplier();
+        static_assert(KEYWORD_HASH_MULTIPLIER != 0, "no perfect hash for the keyword set, enlarge KEYWORD_TABLE_SIZE");
+
+        constexpr std::array<const Keyword*, KEYWORD_TABLE_SIZE> BuildKeywordTable() {
+            std::array<const Keyword*, KEYWORD_TABLE_SIZE> table{};
+            for (const Keyword& keyword : KEYWORDS) {
+                table[KeywordHash(keyword.word, KEYWORD_HASH_MULTIPLIER)] = &keyword;
+            }
+            return table;
+        }
+
+        constexpr std::array<const Keyword*, KEYWORD_TABLE_SIZE> KEYWORD_TABLE = BuildKeywordTable();
+
+        // Returns keyword for lexeme or nullptr if lexeme is an identifier --one table load and one compare
+        const Keyword* FindKeyword(std::string_view lexeme) {
+            const Keyword* keyword = KEYWORD_TABLE[KeywordHash(lexeme, KEYWORD_HASH_MULTIPLIER)];
+            return keyword != nullptr && keyword->word == lexeme ? keyword : nullptr;
+        }
+
+        const Token EOF_TOKEN{token_type::Eof{}};
+    }  // namespace
+
+    std::ostream& operator<<(std::ostream& os, const LiteralText& text) {
+        return os << text.Text();
+    }
+
+    LiteralText StringPool::Add(std::string_view text) {
+        constexpr size_t align = alignof(string_view);
+        size_t size = (sizeof(string_view) + text.size() + align - 1) & ~(align - 1); // next text stays aligned
+        char* p = pos_;
+        if (size > BLOCK_MAX / 4) { // would waste much of a regular block --own block, current one stays open
+            p = blocks_.emplace_back(make_unique<char[]>(size)).get();
+        } else {
+            if (p == nullptr || size > static_cast<size_t>(end_ - p)) {
+                p = blocks_.emplace_back(make_unique<char[]>(next_block_)).get(); // new[] is aligned for string_view
+                end_ = p + next_block_;
+                next_block_ = std::min(next_block_ * 2, BLOCK_MAX);
+            }
+            pos_ = p + size;
+        }
+        char* chars = p + sizeof(string_view);
+        std::copy(text.begin(), text.end(), chars);
+        return LiteralText(new (p) string_view(chars, text.size()));
+    }
+
     bool operator==(const Token& lhs, const Token& rhs) {
         using namespace token_type;
 
-        if (lhs.index() != rhs.index()) {
+        if (lhs.Kind() != rhs.Kind()) {
             return false;
         }
         if (lhs.Is<Char>()) {
@@ -74,236 +223,312 @@ namespace parse {
         return os << "Unknown token :("sv;
     }
 
-    Lexer::Lexer(std::istream& input): input_(input) {
+    Lexer::Lexer(std::istream& input)
+            : input_data_(istreambuf_iterator<char>(input), istreambuf_iterator<char>()) {
+        pos_ = input_data_.data();
+        end_ = pos_ + input_data_.size();
+        line_begin_ = pos_;
         NextToken(); // parse first token in constructor --may be Eof-- to avoid CurrentToken null pointer
     }
 
+    Lexer::Lexer(std::string_view source)
+            : pos_(source.data()), end_(source.data() + source.size()), line_begin_(source.data()) {
+        NextToken();
+    }
+
+    Lexer::Lexer(std::string_view source, runtime::LocalSymbolTable& names)
+            : pos_(source.data()), end_(source.data() + source.size()), line_begin_(source.data()), local_names_(&names) {
+        NextToken();
+    }
+
+    Lexer::Lexer(MappedFile file): file_(std::move(file)) {
+        pos_ = file_->Data().data();
+        end_ = pos_ + file_->Data().size();
+        line_begin_ = pos_;
+        NextToken();
+    }
+
+    const std::shared_ptr<StringPool>& Lexer::Strings() const {
+        return strings_;
+    }
+
+    bool Lexer::GetChar(char& c) {
+        if (pos_ == end_) {
+            return false;
+        }
+        c = *pos_++;
+        return true;
+    }
+
     void Lexer::RemoveSpaces() {
-        while(input_.get(c_)){
-            if (c_ != ' '){
-                input_.unget();
-                return;
-            }
+        if (pos_ != end_ && *pos_ == ' ') { // most lexemes are split by one space --no kernel call for it
+            pos_ = scan::SkipSpaces(pos_ + 1, end_);
         }
     }
 
-    void Lexer::RemoveComment() {
-        getline(input_, line_);
+    void Lexer::RemoveComment() { // skips the rest of line including its end
+        const char* line_end = scan::FindLineEnd(pos_, end_);
+        if (line_end != end_) {
+            pos_ = line_end + 1;
+            StartLine();
+        } else {
+            pos_ = end_;
+        }
     }
 
-    void Lexer::RemoveEmptyLines() {
-        int space_count = 0;
-        while (input_.get(c_)){
-            if (c_ == '#'){ // if # met gets all line
-                getline(input_, line_);
-                space_count = 0;
-            } else {
-                if (c_ != ' ' && c_ != '\n') {
-                    for (int i = 0; i <= space_count; i++){ // if non-space met puts all chars back in stream
-                        input_.unget();
-                    }
-                    return;
-                } else if (c_ == '\n') { // if next line char met starts checkup new line with space_count set to 0
-                    space_count = 0;
-                } else {
-                    space_count++;
-                }
+    int Lexer::RemoveEmptyLines() {
+        while (true) {
+            const char* begin = pos_;
+            const char* line_start = pos_;
+            pos_ = scan::SkipBlank(pos_, end_, &line_start); // stops at first char of a non-empty line
+            if (line_start != begin) {
+                line_ += static_cast<uint32_t>(std::count(begin, line_start, '\n'));
+                line_begin_ = line_start;
             }
+            if (pos_ != end_ && *pos_ == '#') { // if # met gets all line
+                RemoveComment();
+                continue;
+            }
+            return static_cast<int>(pos_ - line_start);
         }
     }
 
-    Token Lexer::ParseNextToken() {
+    const Token& Lexer::ParseNextToken() {
         if (c_ == '#') { // if next token position starts with comment
             RemoveComment();
-            if (!CurrentToken().Is<token_type::Newline>()) {
-                doc_.emplace_back(token_type::Newline{}); // if token position wasn't a new line then new line lexeme
-                return doc_.at(doc_.size() - 1);
+            at_line_start_ = true;
+            if (!LastToken().Is<token_type::Newline>()) {
+                Emit(token_type::Newline{}); // if token position wasn't a new line then new line lexeme
+                return LastToken();
             }
         } else if (c_ == '\n'){
-            doc_.emplace_back(token_type::Newline{});
-            return doc_.at(doc_.size() - 1);
-        }
-        if (c_ == '=' || c_ == '!' || c_ == '<' || c_ == '>') { return GetEqLexeme(); } // Get of %%%%% parses =, !, <, >, ==, !=, <=, >=,
-        if (marks_chars.count(c_) > 0 || c_ == '.') { return GetCharLexeme(); } // Get of %%%%% parses =, !, <, >, ==, !=, <=, >=
-        if (c_ == '\'' || c_ == '\"') { return GetStringLexeme(); }  // Get of %%%%% get string lexeme
-        if (isdigit(c_)) {return GetNumberLexeme();} // Get of %%%%% get number lexeme
-        if (c_ == 95 || (c_ > 64 && c_ < 91) || (c_ > 96 && c_ < 123)) {return GetIdOrKeyLexeme();} // Get of %%%%% get id lexeme
-        if (c_ == ' ') {throw LexerError("ParseNextToken(): FLAG error-- whitespace in ParseNextToken"s);}
+            at_line_start_ = true;
+            Emit(token_type::Newline{});
+            StartLine();
+            return LastToken();
+        }
+        if (IsCharClass(c_, CHAR_COMPARE)) { return GetEqLexeme(); } // Get of %%%%% parses =, !, <, >, ==, !=, <=, >=,
+        if (IsCharClass(c_, CHAR_OPERATOR | CHAR_DOT)) { return GetCharLexeme(); } // Get of %%%%% parses , ( ) * / + - : ; .
+        if (IsCharClass(c_, CHAR_QUOTE)) { return GetStringLexeme(); }  // Get of %%%%% get string lexeme
+        if (IsCharClass(c_, CHAR_DIGIT)) {return GetNumberLexeme();} // Get of %%%%% get number lexeme
+        if (IsCharClass(c_, CHAR_ID_START)) {return GetIdOrKeyLexeme();} // Get of %%%%% get id lexeme
+        if (IsCharClass(c_, CHAR_WHITESPACE)) {throw LexerError("ParseNextToken(): FLAG error-- whitespace in ParseNextToken"s);}
         throw LexerError("ParseNextToken(): Unknown error-- "s + c_);
     }
 
     const Token& Lexer::CurrentToken() const {
-        return doc_.at(doc_.size() - 1);
+        return window_[current_ % kTokenWindow];
     }
 
-    Token Lexer::NextToken() {
-        if (doc_.empty() || CurrentToken().Is<token_type::Newline>()){
-            RemoveEmptyLines();
-        }
-        if (input_.get(c_)){
-            if (c_ == ' ' && (CurrentToken().Is<token_type::Newline>() || CurrentToken().Is<token_type::Dedent>())) {
-                if (IsIndentLexeme()) { return doc_.at(doc_.size() - 1); }
-            } else if (c_ != ' ' && last_indent_ > 0 && (CurrentToken().Is<token_type::Newline>() || is_dedent_chain_)) { // if no spaces - gets all dedent one by one until last_indent_ == 0, is_dedent_chain_ marks this loop
-                is_dedent_chain_ = true;
-                input_.unget();
-                last_indent_--;
-                doc_.emplace_back(token_type::Dedent{});
-                return doc_.at(doc_.size() - 1);
-            }
-            is_dedent_chain_ = false;
-            return ParseNextToken();
+    const Token& Lexer::LastToken() const {
+        return window_[(produced_ - 1) % kTokenWindow];
+    }
+
+
+    const Token& Lexer::NextToken() {
+        if (current_ + 1 < produced_) { // token was already scanned by PeekToken
+            ++current_;
         } else {
-            if (last_indent_ > 0) {
-                if (!CurrentToken().Is<token_type::Newline>() && !CurrentToken().Is<token_type::Dedent>()){
-                    doc_.emplace_back(token_type::Newline{});
-                } else {
-                    last_indent_--;
-                    doc_.emplace_back(token_type::Dedent{});
-                }
-                return doc_.at(doc_.size() - 1);
+            ProduceToken();
+            current_ = produced_ - 1;
+        }
+        return CurrentToken();
+    }
+
+    const Token& Lexer::PeekToken(size_t n) {
+        if (n >= kTokenWindow) {
+            throw LexerError("PeekToken(): lookahead is wider than token window"s);
+        }
+        while (produced_ <= current_ + n) {
+            size_t produced_before = produced_;
+            ProduceToken();
+            if (produced_ == produced_before) { // Eof is never produced twice --lookahead past Eof is Eof
+                return LastToken();
             }
-            if (!doc_.empty()){
-                if (!CurrentToken().Is<token_type::Newline>() && !CurrentToken().Is<token_type::Eof>() && !CurrentToken().Is<token_type::Dedent>()){
-                    doc_.emplace_back(token_type::Newline{});
-                } else if (!std::holds_alternative<token_type::Eof>(doc_.at(doc_.size() - 1))){
-                    doc_.emplace_back(token_type::Eof{});
-                }
-            } else {
-                doc_.emplace_back(token_type::Eof{});
+        }
+        return window_[(current_ + n) % kTokenWindow];
+    }
+
+    void Lexer::ProduceToken() {
+        if (pending_dedents_ > 0) { // rest of a multi-level dedent
+            --pending_dedents_;
+            Emit(token_type::Dedent{});
+            return;
+        }
+        if (at_line_start_) {
+            at_line_start_ = false;
+            int indent = RemoveEmptyLines();
+            MarkTokenStart();
+            if (pos_ != end_ && UpdateIndent(indent)) {
+                return;
             }
-            return doc_.at(doc_.size() - 1);
+        }
+        MarkTokenStart();
+        if (pos_ != end_) {
+            c_ = *pos_++;
+            ParseNextToken();
+            return;
+        }
+        // end of source: close the last line, then all open blocks, then Eof once
+        if (produced_ != 0 && !LastToken().Is<token_type::Newline>() && !LastToken().Is<token_type::Dedent>()
+            && !LastToken().Is<token_type::Eof>()) {
+            at_line_start_ = true;
+            Emit(token_type::Newline{});
+        } else if (!indents_.empty()) {
+            indents_.pop_back();
+            Emit(token_type::Dedent{});
+        } else if (produced_ == 0 || !LastToken().Is<token_type::Eof>()) {
+            Emit(token_type::Eof{});
         }
     }
 
+    bool Lexer::UpdateIndent(int indent) {
+        int current = indents_.empty() ? 0 : indents_.back();
+        if (indent % INDENT_STEP != 0) {
+            throw LexerError("UpdateIndent(): indentation must be a multiple of two spaces"s);
+        }
+        if (indent > current) {
+            if (indent != current + INDENT_STEP) {
+                throw LexerError("UpdateIndent(): a block must be indented by two spaces"s);
+            }
+            indents_.push_back(indent);
+            Emit(token_type::Indent{});
+            return true;
+        }
+        if (indent < current) {
+            size_t dedents = 0;
+            while (!indents_.empty() && indents_.back() > indent) {
+                indents_.pop_back();
+                ++dedents;
+            }
+            if ((indents_.empty() ? 0 : indents_.back()) != indent) {
+                throw LexerError("UpdateIndent(): dedent doesn't match any outer indentation level"s);
+            }
+            pending_dedents_ = dedents - 1; // first one is emitted now, the rest by the next calls
+            Emit(token_type::Dedent{});
+            return true;
+        }
+        return false;
+    }
+
     // Begin of %%%%% %%%%% %%%%% Get lexeme funcs %%%%% %%%%% %%%%%
     // Begin of %%%%% %%%%% %%%%% Get lexeme funcs %%%%% %%%%% %%%%%
 
-    Token Lexer::GetEqLexeme() {
-        string eq_lexeme;
-        char next_c;
-        input_.get(next_c);
-        if (next_c == '=') {
-            eq_lexeme.push_back(c_);
-            eq_lexeme.push_back(next_c);
-            if (eq_lexeme == "==") { doc_.emplace_back(token_type::Eq{});}
-            else if (eq_lexeme == "!=") { doc_.emplace_back(token_type::NotEq{});}
-            else if (eq_lexeme == "<=") { doc_.emplace_back(token_type::LessOrEq{});}
-            else if (eq_lexeme == ">=") { doc_.emplace_back(token_type::GreaterOrEq{});}
+    const Token& Lexer::GetEqLexeme() {
+        if (pos_ != end_ && *pos_ == '=') {
+            ++pos_;
+            if (c_ == '=') { Emit(token_type::Eq{});}
+            else if (c_ == '!') { Emit(token_type::NotEq{});}
+            else if (c_ == '<') { Emit(token_type::LessOrEq{});}
+            else if (c_ == '>') { Emit(token_type::GreaterOrEq{});}
         } else {
-            input_.unget();
-            doc_.emplace_back(token_type::Char{c_});
+            Emit(token_type::Char{c_});
         }
         RemoveSpaces();
-        return doc_.at(doc_.size() - 1);
+        return LastToken();
     }
 
-    Token Lexer::GetCharLexeme() {
-        doc_.emplace_back(token_type::Char{c_});
+    const Token& Lexer::GetCharLexeme() {
+        Emit(token_type::Char{c_});
         RemoveSpaces();
-        return doc_.at(doc_.size() - 1);
+        return LastToken();
     }
 
-    Token Lexer::GetStringLexeme() {
-        string string_lexeme;
+    const Token& Lexer::GetStringLexeme() {
         char end_marker = c_;
-        while (input_.get(c_)) {
+        const char* begin = pos_;
+        const char* it = begin;
+        while (it != end_ && *it != end_marker && *it != '\\') {
+            if (*it == '\n') {
+                pos_ = it + 1;
+                StartLine();
+            }
+            ++it;
+        }
+        if (it == end_) {
+            throw LexerError("GetStringLexeme(): Wrong string format"s);
+        }
+        pos_ = it;
+        if (*it == end_marker) { // no escapes --lexeme is copied straight from the source
+            ++pos_;
+            Emit(token_type::String{strings_->Add(std::string_view(begin, it - begin))});
+            RemoveSpaces();
+            return LastToken();
+        }
+
+        string& string_lexeme = escaped_; // an escape forces a rewrite, the part before it is copied once
+        string_lexeme.assign(begin, it);
+        while (GetChar()) {
             if (c_ != end_marker) {
                 if (c_ == '\\') {
-                    input_.get(c_);
+                    GetChar();
                     if (c_ == 'n') { c_ = '\n'; }
                     else if (c_ == 't') {c_ = '\t'; }
+                    else if (c_ == '\n') { StartLine(); }
                     { string_lexeme.push_back(c_);}
                 }
-                else { string_lexeme.push_back(c_);}
+                else {
+                    if (c_ == '\n') { StartLine(); }
+                    string_lexeme.push_back(c_);
+                }
             } else if (c_ == '\n') {
                 throw LexerError("GetStringLexeme(): Wrong string format"s);
             } else {
-                doc_.emplace_back(token_type::String{string_lexeme});
+                Emit(token_type::String{strings_->Add(string_lexeme)});
                 RemoveSpaces();
-                return doc_.at(doc_.size() - 1);
+                return LastToken();
             }
         }
         throw LexerError("GetStringLexeme(): Wrong string format"s);
     }
 
-    Token Lexer::GetNumberLexeme() {
-        string number_lexeme;
-        number_lexeme.push_back(c_);
-        while (input_.get(c_)) {
-            if (c_ != ' ' && c_ != '#' && c_ != '\n' && marks_chars.count(c_) == 0) { // while condition is getting the lexeme
-                if (isdigit(c_)) {
-                    number_lexeme.push_back(c_);
-                }
-                else {
-                    throw LexerError("GetNumberLexeme(): Wrong number format"s);
-                }
-            } else {
-                break;
+    const Token& Lexer::GetNumberLexeme() {
+        const char* begin = pos_ - 1; // first digit is already in c_
+        while (pos_ != end_ && !IsCharClass(*pos_, NUMBER_END)) { // while condition is getting the lexeme
+            if (!IsCharClass(*pos_, CHAR_DIGIT)) {
+                throw LexerError("GetNumberLexeme(): Wrong number format"s);
             }
+            ++pos_;
         }
-        input_.unget();
-        doc_.emplace_back(token_type::Number{stoi(number_lexeme)});
+        int value = 0;
+        if (from_chars(begin, pos_, value).ec != std::errc()) { // digits only, so the only error is overflow
+            throw LexerError("GetNumberLexeme(): Number is out of range"s);
+        }
+        Emit(token_type::Number{value});
         RemoveSpaces();
-        return doc_.at(doc_.size() - 1);
+        return LastToken();
     }
 
-    Token Lexer::GetIdOrKeyLexeme() {
-        string str_lexeme;
-        str_lexeme.push_back(c_);
-        while (input_.get(c_)){
-            if (c_ != ' ' && c_ != '#' && c_ != '\n' && c_ != '.' && marks_chars.count(c_) == 0){ // while condition is getting the lexeme
-                str_lexeme.push_back(c_);
-            } else {
-                input_.unget();
-                break;
-            }
+    const Token& Lexer::GetIdOrKeyLexeme() {
+        const char* begin = pos_ - 1; // first char is already in c_
+        while (pos_ != end_ && IsCharClass(*pos_, CHAR_ID_CONTINUE)) {
+            ++pos_;
+        }
+        std::string_view lexeme(begin, pos_ - begin);
+        if (const Keyword* keyword = FindKeyword(lexeme)) {
+            keyword->make(NextSlot());
+        } else {
+            // if not a reserved word - get an ID lexeme with the value
+            Emit(token_type::Id{local_names_ != nullptr ? local_names_->Intern(lexeme) : runtime::Symbol(lexeme)});
         }
-        if (str_lexeme == "class") { doc_.emplace_back(token_type::Class{});}
-        else if (str_lexeme == "return") { doc_.emplace_back(token_type::Return{});}
-        else if (str_lexeme == "if") { doc_.emplace_back(token_type::If{});}
-        else if (str_lexeme == "else") { doc_.emplace_back(token_type::Else{});}
-        else if (str_lexeme == "def") { doc_.emplace_back(token_type::Def{});}
-        else if (str_lexeme == "print") { doc_.emplace_back(token_type::Print{});}
-        else if (str_lexeme == "and") { doc_.emplace_back(token_type::And{});}
-        else if (str_lexeme == "or") { doc_.emplace_back(token_type::Or{});}
-        else if (str_lexeme == "not") { doc_.emplace_back(token_type::Not{});}
-        else if (str_lexeme == "None") { doc_.emplace_back(token_type::None{});}
-        else if (str_lexeme == "True") { doc_.emplace_back(token_type::True{});}
-        else if (str_lexeme == "False") { doc_.emplace_back(token_type::False{});}
-        else {doc_.emplace_back(token_type::Id{str_lexeme});} // if not a reserved word - get an ID lexeme with the value
         RemoveSpaces(); // removes all spaces before next lexeme
-        return doc_.at(doc_.size() - 1);
+        return LastToken();
     }
 
-    bool Lexer::IsIndentLexeme() { // returns true if indent/dedent occurred
-        int indent_count = 1; // the first space counted
-        while (input_.get(c_)){
-            if (c_ == ' ') {
-                indent_count++;
-                if (indent_count / 2 - 1 == last_indent_) {
-                    last_indent_++;
-                    doc_.emplace_back(token_type::Indent{});
-                    return true;
-                }
-            } else {
-                if (indent_count / 2 == last_indent_) { // if char is not whitespace  - check if no dedent occurred
-                    return false;
-                } else {
-                    if (indent_count / 2 + 1 != last_indent_){ // dedent occurred
-                        for (int i = 0; i < 2; i++) { // puts back two spaces to reduce spaces in line if dedent-chain
-                            input_.unget();
-                        }
-                    }
-                    input_.unget(); // puts not-space-char back
-                    last_indent_--;
-                    doc_.emplace_back(token_type::Dedent{});
-                    return true;
-                }
-            }
-        }
-        return false;
-    }
     // End of %%%%% %%%%% %%%%% Get lexeme funcs %%%%% %%%%% %%%%%
     // End of %%%%% %%%%% %%%%% Get lexeme funcs %%%%% %%%%% %%%%%
 
+    TokenReplay::TokenReplay(const vector<Token>& tokens): tokens_(tokens) {}
+
+    const Token& TokenReplay::CurrentToken() const {
+        return pos_ < tokens_.size() ? tokens_[pos_] : EOF_TOKEN;
+    }
+
+    const Token& TokenReplay::NextToken() {
+        if (pos_ < tokens_.size()) {
+            ++pos_;
+        }
+        return CurrentToken();
+    }
+
 }  // namespace parse
\ No newline at end of file
@@ -1,33 +1,94 @@
 #pragma once
 
+#include "mapped_file.h"
+#include "symbol.h"
+
+#include <array>
+#include <cstdint>
 #include <iosfwd>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <variant>
 #include <vector>
 #include <unordered_map>
-#include <set>
 
 namespace parse {
 
+    namespace detail {
+        inline constexpr std::string_view EMPTY_LITERAL_TEXT{};
+    }  // namespace detail
+
+    // Text of a string literal kept in a StringPool --a single pointer, so it fits a token payload
+    // Valid while its pool lives, compares by text
+    class LiteralText {
+    public:
+        constexpr LiteralText() noexcept = default;
+
+        explicit constexpr LiteralText(const std::string_view* text) noexcept: text_(text) {}
+
+        [[nodiscard]] std::string_view Text() const {
+            return *text_;
+        }
+
+        friend bool operator==(const LiteralText& lhs, const LiteralText& rhs) {
+            return lhs.Text() == rhs.Text();
+        }
+
+        friend bool operator!=(const LiteralText& lhs, const LiteralText& rhs) {
+            return !(lhs == rhs);
+        }
+
+    private:
+        const std::string_view* text_ = &detail::EMPTY_LITERAL_TEXT;
+    };
+
+    std::ostream& operator<<(std::ostream& os, const LiteralText& text);
+
+    // Append-only storage for texts of string literal tokens, freed all at once with the pool
+    // Texts are packed into blocks that grow up to BLOCK_MAX, so adding one rarely allocates
+    // Not interned process-wide --a pool lives as long as the tokens that need it: a lexer's pool is shared
+    // with whatever keeps its tokens beyond the lexer
+    class StringPool {
+    public:
+        StringPool() = default;
+
+        StringPool(const StringPool&) = delete;
+        StringPool& operator=(const StringPool&) = delete;
+
+        // Copies text into the pool
+        LiteralText Add(std::string_view text);
+
+    private:
+        static constexpr size_t BLOCK_MIN = 256; // a pool of a short statement stays small
+        static constexpr size_t BLOCK_MAX = 64 << 10; // longer texts get a block of their own
+
+        std::vector<std::unique_ptr<char[]>> blocks_;
+        char* pos_ = nullptr; // free space of the last regular block
+        char* end_ = nullptr;
+        size_t next_block_ = BLOCK_MIN;
+    };
+
     namespace token_type {
 
         struct Number {  // --lexeme «number»
             int value;   // number
         };
 
-        struct Id {             // lexeme «identifier»
-            std::string value;  // identifier's name
+        struct Id {                 // lexeme «identifier»
+            runtime::Symbol value;  // identifier's interned name
         };
 
         struct Char {    // --lexeme «character»
             char value;  // character's code
         };
 
-        struct String {  // lexeme «string constant»
-            std::string value;
+        struct String {        // lexeme «string constant»
+            LiteralText value;  // literal's text in the lexer's StringPool, escapes already replaced
         };
 
         struct Class {};    // --lexeme «class»
@@ -52,33 +113,132 @@ namespace parse {
         struct False {};        // lexeme «False»
     }  // namespace token_type
 
-    using TokenBase
-            = std::variant<token_type::Number, token_type::Id, token_type::Char, token_type::String,
+    // List of token types --a token's kind is the index of its type in the list
+    template <typename... Types>
+    struct TokenTypeList {
+        static constexpr size_t size = sizeof...(Types);
+
+        template <typename T>
+        static constexpr uint8_t IndexOf() {
+            constexpr bool matches[] = {std::is_same_v<T, Types>...};
+            for (uint8_t i = 0; i < size; ++i) {
+                if (matches[i]) {
+                    return i;
+                }
+            }
+            return size;
+        }
+    };
+
+    // Kinds are written to token caches --append new types to the end
+    using TokenTypes
+            = TokenTypeList<token_type::Number, token_type::Id, token_type::Char, token_type::String,
             token_type::Class, token_type::Return, token_type::If, token_type::Else,
             token_type::Def, token_type::Newline, token_type::Print, token_type::Indent,
             token_type::Dedent, token_type::And, token_type::Or, token_type::Not,
             token_type::Eq, token_type::NotEq, token_type::LessOrEq, token_type::GreaterOrEq,
             token_type::None, token_type::True, token_type::False, token_type::Eof>;
 
-    struct Token : TokenBase {
-        using TokenBase::TokenBase;
+    template <typename T>
+    inline constexpr uint8_t TOKEN_KIND = TokenTypes::IndexOf<T>();
+
+    // Value returned by As for token types without payload
+    template <typename T>
+    inline constexpr T EMPTY_TOKEN_VALUE{};
+
+    // Fixed-size token: kind, source position and an 8-byte payload, trivially copyable
+    // Names are interned symbols and string literals point into a StringPool, so a token owns no memory
+    class Token {
+    public:
+        Token() noexcept: kind_(TOKEN_KIND<token_type::Number>), column_(0) {} // Number 0, same as a default variant
+
+        template <typename T, typename = std::enable_if_t<TOKEN_KIND<T> < TokenTypes::size>>
+        Token(T token) noexcept: kind_(0), column_(0) {  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+            emplace(token);
+        }
 
         template <typename T>
         [[nodiscard]] bool Is() const {
-            return std::holds_alternative<T>(*this);
+            return kind_ == TOKEN_KIND<T>;
         }
 
         template <typename T>
         [[nodiscard]] const T& As() const {
-            return std::get<T>(*this);
+            if (const T* value = TryAs<T>()) {
+                return *value;
+            }
+            throw std::bad_variant_access();
         }
 
         template <typename T>
         [[nodiscard]] const T* TryAs() const {
-            return std::get_if<T>(this);
+            if (!Is<T>()) {
+                return nullptr;
+            }
+            if constexpr (std::is_same_v<T, token_type::Number>) {
+                return &number_;
+            } else if constexpr (std::is_same_v<T, token_type::Id>) {
+                return &id_;
+            } else if constexpr (std::is_same_v<T, token_type::Char>) {
+                return &char_;
+            } else if constexpr (std::is_same_v<T, token_type::String>) {
+                return &string_;
+            } else {
+                return &EMPTY_TOKEN_VALUE<T>;
+            }
+        }
+
+        // Replaces the token keeping its position
+        template <typename T>
+        void emplace(T token = {}) {
+            kind_ = TOKEN_KIND<T>;
+            if constexpr (std::is_same_v<T, token_type::Number>) {
+                number_ = token;
+            } else if constexpr (std::is_same_v<T, token_type::Id>) {
+                id_ = token;
+            } else if constexpr (std::is_same_v<T, token_type::Char>) {
+                char_ = token;
+            } else if constexpr (std::is_same_v<T, token_type::String>) {
+                string_ = token;
+            }
+        }
+
+        // Index of the token type in TokenTypes
+        [[nodiscard]] uint8_t Kind() const {
+            return kind_;
+        }
+
+        // Position of the token's first char, both 1-based --0 if the token didn't come from a lexer
+        [[nodiscard]] uint32_t Line() const {
+            return line_;
+        }
+
+        [[nodiscard]] uint32_t Column() const {
+            return column_;
         }
+
+        void SetPosition(uint32_t line, uint32_t column) {
+            line_ = line;
+            column_ = column < MAX_COLUMN ? column : MAX_COLUMN;
+        }
+
+    private:
+        static constexpr uint32_t MAX_COLUMN = (1U << 24) - 1; // longer lines report this column
+
+        uint32_t kind_ : 8;
+        uint32_t column_ : 24;
+        uint32_t line_ = 0;
+        union {
+            token_type::Number number_{0};
+            token_type::Id id_;
+            token_type::Char char_;
+            token_type::String string_;
+        };
     };
 
+    static_assert(sizeof(Token) == 16, "Token must stay 16 bytes");
+    static_assert(std::is_trivially_copyable_v<Token>, "Token must stay trivially copyable");
+
     bool operator==(const Token& lhs, const Token& rhs);
     bool operator!=(const Token& lhs, const Token& rhs);
 
@@ -89,33 +249,19 @@ namespace parse {
         using std::runtime_error::runtime_error;
     };
 
-    class Lexer {
+    // Sequence of tokens the parser reads --scanned on demand by Lexer or delivered by another producer
+    class TokenStream {
     public:
-        explicit Lexer(std::istream& input);
+        virtual ~TokenStream() = default;
 
-        Token GetEqLexeme();
+        [[nodiscard]] virtual const Token& CurrentToken() const = 0; // returns current token or token_type::Eof, if stream ends
 
-        Token GetCharLexeme();
+        // Moves to the next token and returns it or token_type::Eof, if stream ends
+        // Reference stays valid until the stream moves kTokenWindow tokens further
+        virtual const Token& NextToken() = 0;
 
-        Token GetStringLexeme();
-
-        Token GetNumberLexeme();
-
-        Token GetIdOrKeyLexeme();
-
-        bool IsIndentLexeme(); //
-
-        void RemoveSpaces(); // supporting func --removes all spaces before next char in stream
-
-        void RemoveComment(); // supporting func --removes all line after # !-- need Newline if line isn't empty
-
-        void RemoveEmptyLines(); // supporting func --removes empty lines
-
-        Token ParseNextToken(); // parses next token from stream
-
-        [[nodiscard]] const Token& CurrentToken() const; // returns current token pointer or token_type::Eof, if stream ends
-
-        Token NextToken(); // returns current token or token_type::Eof, if stream ends
+        // Streams keep at least the last kTokenWindow tokens --current one and lookahead
+        static constexpr size_t kTokenWindow = 4;
 
         // If current token has type T, method returns its pointer
         // Else exception LexerError
@@ -163,17 +309,128 @@ namespace parse {
                 }
             }
         }
+    };
+
+    class Lexer : public TokenStream {
+    public:
+        // Reads the whole stream into an owned buffer, then scans it as a contiguous source
+        explicit Lexer(std::istream& input);
+
+        // Scans caller-owned contiguous source --source must outlive the lexer
+        explicit Lexer(std::string_view source);
+
+        // Interns Id names into names instead of the process-wide table, so a worker thread takes no lock per name
+        // Id tokens hold local symbols until they are mapped through names.Merge()
+        Lexer(std::string_view source, runtime::LocalSymbolTable& names);
+
+        // Scans memory-mapped file without copying it
+        explicit Lexer(MappedFile file);
+
+        Lexer(const Lexer&) = delete;
+        Lexer& operator=(const Lexer&) = delete;
+
+        // Pool with texts of the scanned String tokens --hold it to keep the tokens after the lexer is gone
+        [[nodiscard]] const std::shared_ptr<StringPool>& Strings() const;
+
+        const Token& GetEqLexeme();
+
+        const Token& GetCharLexeme();
+
+        const Token& GetStringLexeme();
+
+        const Token& GetNumberLexeme();
+
+        const Token& GetIdOrKeyLexeme();
+
+        void RemoveSpaces(); // supporting func --removes all spaces before next char in stream
+
+        void RemoveComment(); // supporting func --removes all line after # !-- need Newline if line isn't empty
+
+        int RemoveEmptyLines(); // supporting func --removes empty and comment-only lines, returns indent width of the next line
+
+        const Token& ParseNextToken(); // parses next token from source
+
+        [[nodiscard]] const Token& CurrentToken() const override;
+
+        const Token& NextToken() override;
+
+        // Returns n-th token after current without moving to it, n must be less than kTokenWindow
+        const Token& PeekToken(size_t n = 1);
 
     private:
+        void ProduceToken(); // scans one more token into the window --nothing new after Eof
+
+        // Compares line indent with the indent stack, emits Indent or the first of Dedents
+        // Returns false if indentation didn't change, throws LexerError unless indent steps by INDENT_STEP spaces
+        bool UpdateIndent(int indent);
+
+        static constexpr int INDENT_STEP = 2; // a block is indented two spaces deeper than its header
+
+        [[nodiscard]] const Token& LastToken() const; // last scanned token, may be ahead of current one
+
+        // Builds scanned token in place in the window slot --the slot's previous token is dropped
+        template <typename T>
+        const Token& Emit(T&& token) {
+            Token& slot = NextSlot();
+            slot.emplace(std::forward<T>(token));
+            return slot;
+        }
+
+        // Returns window slot for the next scanned token stamped with its position --caller must build the token in it
+        Token& NextSlot() {
+            Token& slot = window_[produced_++ % kTokenWindow];
+            slot.SetPosition(token_line_, token_column_);
+            return slot;
+        }
+
+        // Counts a line whose end was just consumed --pos_ is at the start of the next one
+        void StartLine() {
+            ++line_;
+            line_begin_ = pos_;
+        }
+
+        // Remembers position of the token about to be scanned, Emit stamps it on the token
+        void MarkTokenStart() {
+            token_line_ = line_;
+            token_column_ = static_cast<uint32_t>(pos_ - line_begin_) + 1;
+        }
+
+        bool GetChar(char& c); // reads next source char into c, returns false at the end of source
+        bool GetChar() { return GetChar(c_); }
+
         char c_{};
-        std::istream& input_;
-        std::string line_;
-        std::vector<Token> doc_;
-        int last_indent_ = 0;
+        std::string input_data_; // owned source if lexer was built from a stream
+        std::optional<MappedFile> file_; // owned source if lexer was built from a file
+        const char* pos_ = nullptr; // next source char
+        const char* end_ = nullptr;
+        const char* line_begin_ = nullptr; // first char of the current line
+        uint32_t line_ = 1; // 1-based number of the current line
+        uint32_t token_line_ = 1;
+        uint32_t token_column_ = 1;
+        std::string escaped_; // rewritten string lexeme, reused so its buffer is allocated once
+        std::shared_ptr<StringPool> strings_ = std::make_shared<StringPool>(); // grows with literal text only
+        runtime::LocalSymbolTable* local_names_ = nullptr; // interns Id names if set
+        std::array<Token, kTokenWindow> window_; // ring buffer of scanned tokens
+        size_t produced_ = 0; // number of tokens scanned so far
+        size_t current_ = 0; // number of the current token
+        std::vector<int> indents_; // widths of open indented blocks, innermost last
+        size_t pending_dedents_ = 0; // dedents left to emit for one multi-level dedent
+        bool at_line_start_ = true; // next token starts a new line --indentation must be measured
         std::unordered_map<std::string, int> var_values_;
-        std::set<char> marks_chars {',', '(', ')', '*', '/', '+', '-', ':', ';'};
-        std::string input_data_;
-        bool is_dedent_chain_ = false;
+    };
+
+    // Replays tokens scanned earlier, Eof after the last of them --tokens must outlive the stream
+    class TokenReplay : public TokenStream {
+    public:
+        explicit TokenReplay(const std::vector<Token>& tokens);
+
+        [[nodiscard]] const Token& CurrentToken() const override;
+
+        const Token& NextToken() override;
+
+    private:
+        const std::vector<Token>& tokens_;
+        size_t pos_ = 0;
     };
 
 }  // namespace parse
\ No newline at end of file
@@ -1,14 +1,30 @@
 #include "lexer.h"
+#include "parallel_lexer.h"
+#include "pipelined_lexer.h"
+#include "scan.h"
+#include "token_cache.h"
 #include "test_runner_p.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <sstream>
 #include <string>
+#include <thread>
 
 using namespace std;
 
 namespace parse {
 
 namespace {
+// Expected String token --its text is kept by a pool shared by all tests
+Token StringToken(string_view text) {
+    static StringPool strings;
+    return token_type::String{strings.Add(text)};
+}
+
 void TestSimpleAssignment() {
     istringstream input("x = 42\n"s);
     Lexer lexer(input);
@@ -69,12 +85,12 @@ void TestStrings() {
         R"('word' "two words" 'long string with a double quote " inside' "another long string with single quote ' inside")"s);
     Lexer lexer(input);
 
-    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::String{"word"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"two words"s}));
+    ASSERT_EQUAL(lexer.CurrentToken(), StringToken("word"s));
+    ASSERT_EQUAL(lexer.NextToken(), StringToken("two words"s));
     ASSERT_EQUAL(lexer.NextToken(),
-                 Token(token_type::String{"long string with a double quote \" inside"s}));
+                 StringToken("long string with a double quote \" inside"s));
     ASSERT_EQUAL(lexer.NextToken(),
-                 Token(token_type::String{"another long string with single quote ' inside"s}));
+                 StringToken("another long string with single quote ' inside"s));
 }
 
 void TestOperations() {
@@ -197,7 +213,7 @@ print str(p)
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"y"s}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"hello"s}));
+    ASSERT_EQUAL(lexer.NextToken(), StringToken("hello"s));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Class{}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"Point"s}));
@@ -243,7 +259,7 @@ print str(p)
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"x"s}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{" "s}));
+    ASSERT_EQUAL(lexer.NextToken(), StringToken(" "s));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"str"s}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
@@ -344,13 +360,533 @@ abc#
         ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
         ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"abc"s}));
         ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"#"s}));
+        ASSERT_EQUAL(lexer.NextToken(), StringToken("#"s));
         ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"#123"s}));
+        ASSERT_EQUAL(lexer.NextToken(), StringToken("#123"s));
         ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
         ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
     }
 }
+
+vector<Token> ReadAllTokens(Lexer& lexer) {
+    vector<Token> result{lexer.CurrentToken()};
+    while (!lexer.CurrentToken().Is<token_type::Eof>()) {
+        result.push_back(lexer.NextToken());
+    }
+    return result;
+}
+
+void TestContiguousSources() {
+    const string program = R"(
+class Point:
+  def __init__(x, y): # comment
+    self.x = x
+
+    self.y = 'y'
+print Point(1, 2).x
+)"s;
+    istringstream is(program);
+    Lexer stream_lexer(is);
+    const auto expected = ReadAllTokens(stream_lexer);
+
+    Lexer view_lexer{string_view(program)};
+    ASSERT_EQUAL(ReadAllTokens(view_lexer), expected);
+
+    const string path = (filesystem::temp_directory_path() / "mython_lexer_test.my").string();
+    ofstream(path, ios::binary) << program;
+    {
+        Lexer file_lexer{MappedFile(path)};
+        ASSERT_EQUAL(ReadAllTokens(file_lexer), expected);
+    }
+    ofstream(path, ios::binary | ios::trunc).flush();
+    {
+        Lexer empty_lexer{MappedFile(path)};
+        ASSERT_EQUAL(empty_lexer.CurrentToken(), Token(token_type::Eof{}));
+    }
+    remove(path.c_str());
+}
+
+void TestPeekToken() {
+    istringstream is("x = y + 1\n"s);
+    Lexer lexer(is);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+    ASSERT_EQUAL(lexer.PeekToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.PeekToken(3), Token(token_type::Char{'+'}));
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"y"s}));
+    ASSERT_EQUAL(lexer.PeekToken(3), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{1}));
+    ASSERT_EQUAL(lexer.PeekToken(2), Token(token_type::Eof{}));
+    ASSERT_EQUAL(lexer.PeekToken(3), Token(token_type::Eof{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    ASSERT_THROWS(lexer.PeekToken(Lexer::kTokenWindow), LexerError);
+}
+
+void TestIdsEndAtNonIdChars() {
+    istringstream is("x=y+1\nif a<=b:\n  print'z'\n"s);
+    Lexer lexer(is);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"y"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{1}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::If{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"a"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::LessOrEq{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"b"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Print{}));
+    ASSERT_EQUAL(lexer.NextToken(), StringToken("z"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+}
+
+void TestIndentStack() {
+    istringstream is("if a:\n  if b:\n    x\ny\n"s);
+    Lexer lexer(is);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::If{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"a"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::If{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"b"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"x"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"y"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+
+    // blocks step by two spaces, as the baseline lexer required
+    for (const string& bad_source : {"if a:\n    x\n"s, "if a:\n  x\n   y\n"s, "if a:\n   x\n"s}) {
+        istringstream bad(bad_source);
+        Lexer bad_lexer(bad);
+        try {
+            while (!bad_lexer.NextToken().Is<token_type::Eof>()) {
+            }
+            ASSERT(false);
+        } catch (const LexerError&) {
+        }
+    }
+}
+
+void TestSpscQueue() {
+    constexpr int count = 100000;
+    SpscQueue<int, 64> queue;
+    thread producer([&queue] {
+        for (int i = 0; i < count; ++i) {
+            int value = i;
+            while (!queue.TryPush(std::move(value))) {
+                this_thread::yield();
+            }
+        }
+    });
+    int expected = 0;
+    while (expected < count) {
+        int value = -1;
+        if (queue.TryPop(value)) {
+            ASSERT_EQUAL(value, expected);
+            ++expected;
+        } else {
+            this_thread::yield();
+        }
+    }
+    producer.join();
+    int value = -1;
+    ASSERT(!queue.TryPop(value));
+
+    // blocking sides sleep while the other one stalls, longer than the spin rounds last
+    constexpr int stalled_count = 1000;
+    const atomic<bool> never{false};
+    thread blocking_producer([&queue, &never] {
+        for (int i = 0; i < stalled_count; ++i) {
+            int value = i;
+            ASSERT(queue.Push(std::move(value), never));
+            if (i == 100) {
+                this_thread::sleep_for(2ms); // consumer sleeps on the empty ring
+            }
+        }
+    });
+    for (int i = 0; i < stalled_count; ++i) {
+        if (i == 500) {
+            this_thread::sleep_for(2ms); // producer sleeps on the full ring
+        }
+        queue.Pop(value);
+        ASSERT_EQUAL(value, i);
+    }
+    blocking_producer.join();
+
+    // a producer sleeping on the full ring leaves once cancelled
+    atomic<bool> cancel{false};
+    thread cancelled([&queue, &cancel] {
+        for (int i = 0;; ++i) {
+            int value = i;
+            if (!queue.Push(std::move(value), cancel)) {
+                return;
+            }
+        }
+    });
+    this_thread::sleep_for(2ms);
+    cancel.store(true);
+    queue.WakeAll();
+    cancelled.join();
+}
+
+void TestPipelinedLexer() {
+    string program;
+    for (int i = 0; i < 500; ++i) { // several times more tokens than the ring holds
+        program += "class C"s + to_string(i) + ":\n  def f(x):\n    return x + "s + to_string(i) + " # c\n\nprint 'a', C"s
+                   + to_string(i) + "().f(1)\n"s;
+    }
+    Lexer serial{string_view(program)};
+    const auto expected = ReadAllTokens(serial);
+    ASSERT(expected.size() > 2 * PipelinedLexer::kQueueCapacity);
+
+    PipelinedLexer pipelined{string_view(program)};
+    vector<Token> tokens{pipelined.CurrentToken()};
+    while (!pipelined.CurrentToken().Is<token_type::Eof>()) {
+        tokens.push_back(pipelined.NextToken());
+    }
+    ASSERT_EQUAL(tokens, expected);
+    ASSERT_EQUAL(pipelined.NextToken(), Token(token_type::Eof{}));
+
+    istringstream is(program);
+    PipelinedLexer from_stream(is);
+    ASSERT_EQUAL(from_stream.ExpectNext<token_type::Id>().value, runtime::Symbol("C0"));
+
+    { // a stream is scanned in blocks cut at top-level statements, strings and comments may cross the blocks
+        string long_program;
+        for (int i = 0; long_program.size() < 3 * PipelinedLexer::kReadSize; ++i) {
+            long_program += "if x"s + to_string(i) + ":\n  y = 'two\nclass Lines' # it's\nelse:\n  print \"\\\"\"\n"s
+                            + "# 'comment\nz = "s + to_string(i) + "\n\n"s;
+        }
+        Lexer long_serial{string_view(long_program)};
+        vector<Token> serial_tokens;
+        vector<pair<uint32_t, uint32_t>> serial_positions;
+        for (const Token* token = &long_serial.CurrentToken();; token = &long_serial.NextToken()) {
+            serial_tokens.push_back(*token);
+            serial_positions.emplace_back(token->Line(), token->Column());
+            if (token->Is<token_type::Eof>()) {
+                break;
+            }
+        }
+        istringstream long_stream(long_program);
+        PipelinedLexer streamed(long_stream);
+        vector<Token> streamed_tokens;
+        vector<pair<uint32_t, uint32_t>> streamed_positions;
+        for (const Token* token = &streamed.CurrentToken();; token = &streamed.NextToken()) {
+            streamed_tokens.push_back(*token);
+            streamed_positions.emplace_back(token->Line(), token->Column());
+            if (token->Is<token_type::Eof>()) {
+                break;
+            }
+        }
+        ASSERT_EQUAL(streamed_tokens, serial_tokens);
+        ASSERT(streamed_positions == serial_positions);
+    }
+
+    { // tokens of the first block reach the parser while the rest of the stream is held back
+        // Gives text up to held_from, then waits for release before it gives the rest --a second at most
+        class HeldBackBuffer : public streambuf {
+        public:
+            HeldBackBuffer(string text, size_t held_from): text_(std::move(text)), held_from_(held_from) {
+                setg(text_.data(), text_.data(), text_.data() + held_from_);
+            }
+
+            atomic<bool> released{false};
+            bool timed_out = false;
+
+        protected:
+            int_type underflow() override {
+                if (gptr() == text_.data() + text_.size()) {
+                    return traits_type::eof();
+                }
+                auto deadline = chrono::steady_clock::now() + 1s;
+                while (!released.load() && !(timed_out = chrono::steady_clock::now() > deadline)) {
+                    this_thread::sleep_for(1ms);
+                }
+                setg(text_.data(), text_.data() + held_from_, text_.data() + text_.size());
+                return traits_type::to_int_type(*gptr());
+            }
+
+        private:
+            string text_;
+            size_t held_from_;
+        };
+
+        string head;
+        while (head.size() < 2 * PipelinedLexer::kReadSize) {
+            head += "x = 1\n"s;
+        }
+        HeldBackBuffer buffer(head + "y = 2\n"s, head.size());
+        istream held_back(&buffer);
+        PipelinedLexer streamed(held_back);
+        ASSERT_EQUAL(streamed.CurrentToken(), Token(token_type::Id{"x"s}));
+        buffer.released = true;
+        while (!streamed.NextToken().Is<token_type::Eof>()) {
+        }
+        ASSERT(!buffer.timed_out);
+    }
+
+    { // consumer stops early while the producer waits on the full ring
+        PipelinedLexer abandoned{string_view(program)};
+        abandoned.NextToken();
+    }
+
+    PipelinedLexer failing{"x = 1\ny = 2 $\n"sv};
+    ASSERT_EQUAL(failing.CurrentToken(), Token(token_type::Id{"x"s}));
+    for (int i = 0; i < 6; ++i) { // error surfaces at its position, not earlier
+        failing.NextToken();
+    }
+    ASSERT_EQUAL(failing.CurrentToken(), Token(token_type::Number{2}));
+    try {
+        failing.NextToken();
+        ASSERT(false);
+    } catch (const LexerError&) {
+    }
+}
+
+void TestSplitTopLevel() {
+    const string program = "class A:\n  x = 1\n# c\n  y = 2\nif a:\n  b\nelse:\n  c\nelse_ = 1\n\nprint 1\n"s;
+    auto chunks = SplitTopLevel(program, 100, 1);
+    vector<string_view> expected{"class A:\n  x = 1\n# c\n  y = 2\n"sv, "if a:\n  b\nelse:\n  c\n"sv, "else_ = 1\n\n"sv,
+                                 "print 1\n"sv};
+    ASSERT_EQUAL(chunks, expected);
+    ASSERT_EQUAL(SplitTopLevel(program, 1, 1).size(), 1U);
+    ASSERT_EQUAL(SplitTopLevel(program, 100, program.size()).size(), 1U);
+}
+
+void TestParallelLexer() {
+    string program;
+    for (int i = 0; i < 300; ++i) {
+        program += "class C"s + to_string(i) + ":\n  def f(x):\n    if x:\n      return 'a'\n    return \"s\nprint "s
+                   + to_string(i) + "\n\"\n\nprint C"s + to_string(i) + "().f(1) # c\n"s; // some strings span a line that looks like a statement
+    }
+    Lexer serial{string_view(program)};
+    const auto expected = ReadAllTokens(serial);
+    for (size_t threads : {1, 3, 8}) {
+        ParallelLexer parallel{string_view(program), threads, 64};
+        vector<Token> tokens{parallel.CurrentToken()};
+        while (!parallel.CurrentToken().Is<token_type::Eof>()) {
+            tokens.push_back(parallel.NextToken());
+        }
+        ASSERT_EQUAL(tokens, expected);
+    }
+
+    string clean;
+    for (int i = 0; i < 300; ++i) {
+        clean += "class C"s + to_string(i) + ":\n  def f(x):\n    return x\n\nprint C"s + to_string(i) + "().f(1)\n"s;
+    }
+    Lexer clean_serial{string_view(clean)};
+    ParallelLexer clean_parallel{string_view(clean), 4, 64};
+    const auto clean_expected = ReadAllTokens(clean_serial);
+    vector<Token> clean_tokens{clean_parallel.CurrentToken()};
+    while (!clean_parallel.CurrentToken().Is<token_type::Eof>()) {
+        clean_tokens.push_back(clean_parallel.NextToken());
+    }
+    ASSERT_EQUAL(clean_tokens, clean_expected);
+    for (size_t i = 0; i < clean_tokens.size(); ++i) { // Dedents closing a chunk may sit elsewhere, names may not
+        if (clean_tokens[i].Is<token_type::Id>()) {
+            ASSERT_EQUAL(clean_tokens[i].Line(), clean_expected[i].Line());
+            ASSERT_EQUAL(clean_tokens[i].Column(), clean_expected[i].Column());
+        }
+    }
+
+    const string failing = clean + "x = $\n"s + clean;
+    ParallelLexer failing_parallel{string_view(failing), 4, 64};
+    size_t read = 1;
+    try {
+        while (!failing_parallel.NextToken().Is<token_type::Eof>()) {
+            ++read;
+        }
+        ASSERT(false);
+    } catch (const LexerError&) {
+    }
+    ASSERT_EQUAL(read, clean_expected.size() + 1); // clean part without its Eof, then x and =
+}
+
+void TestTokenCache() {
+    const string program = R"(
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = "a\tb"
+  def __str__():
+    return 'p' + str(self.x) + "a\tb"
+print Point(123456789, 0), x >= 1 != 2
+)"s;
+    Lexer lexer{string_view(program)};
+    const auto expected = ReadAllTokens(lexer);
+
+    ostringstream out;
+    WriteTokenCache(program, out);
+    const string cache = out.str();
+    ASSERT(IsTokenCacheOf(cache, program));
+    ASSERT(!IsTokenCacheOf(cache, program + " "s));
+
+    TokenStreamLexer replay{string_view(cache)};
+    ASSERT_EQUAL(replay.SourceHash(), HashSource(program));
+    vector<Token> tokens{replay.CurrentToken()};
+    while (!replay.CurrentToken().Is<token_type::Eof>()) {
+        tokens.push_back(replay.NextToken());
+    }
+    ASSERT_EQUAL(tokens, expected);
+    ASSERT_EQUAL(replay.NextToken(), Token(token_type::Eof{}));
+
+    istringstream is(cache);
+    TokenStreamLexer from_stream(is);
+    ASSERT_EQUAL(from_stream.ExpectNext<token_type::Id>().value, runtime::Symbol("Point"));
+
+    try {
+        TokenStreamLexer truncated{string_view(cache).substr(0, cache.size() - 3)};
+        while (!truncated.NextToken().Is<token_type::Eof>()) {
+        }
+        ASSERT(false);
+    } catch (const TokenCacheError&) {
+    }
+    try {
+        TokenStreamLexer not_cache{string_view(program)};
+        ASSERT(false);
+    } catch (const TokenCacheError&) {
+    }
+
+    // magic, version and hash, then damaged tables or tokens
+    const string header = cache.substr(0, 4 + 1 + 8);
+    try {
+        TokenStreamLexer huge_table{header + "\xff\xff\xff\xff\x0f"s};
+        ASSERT(false);
+    } catch (const TokenCacheError&) {
+    }
+    try {
+        string number{static_cast<char>(TOKEN_KIND<token_type::Number>)};
+        TokenStreamLexer huge_number{header + "\x00\x00"s + number + "\x80\x80\x80\x80\x10"s};
+        ASSERT(false);
+    } catch (const TokenCacheError&) {
+    }
+}
+
+void TestTokenPositions() {
+    static_assert(sizeof(Token) == 16);
+
+    Lexer lexer("# note\n\nx = 'a\nb'  # tail\n  \nif x:\n  y\n"sv);
+
+    auto expect_at = [](const Token& token, const Token& expected, uint32_t line, uint32_t column) {
+        ASSERT_EQUAL(token, expected);
+        ASSERT_EQUAL(token.Line(), line);
+        ASSERT_EQUAL(token.Column(), column);
+    };
+    expect_at(lexer.CurrentToken(), token_type::Id{"x"s}, 3, 1);
+    expect_at(lexer.NextToken(), token_type::Char{'='}, 3, 3);
+    expect_at(lexer.NextToken(), StringToken("a\nb"s), 3, 5);
+    expect_at(lexer.NextToken(), token_type::Newline{}, 4, 5); // string spans two lines
+    expect_at(lexer.NextToken(), token_type::If{}, 6, 1);
+    expect_at(lexer.NextToken(), token_type::Id{"x"s}, 6, 4);
+    expect_at(lexer.NextToken(), token_type::Char{':'}, 6, 5);
+    expect_at(lexer.NextToken(), token_type::Newline{}, 6, 6);
+    expect_at(lexer.NextToken(), token_type::Indent{}, 7, 3);
+    expect_at(lexer.NextToken(), token_type::Id{"y"s}, 7, 3);
+}
+
+void TestStringPool() {
+    StringPool pool;
+    vector<LiteralText> texts;
+    for (int i = 0; i < 1000; ++i) { // spans several growing blocks
+        texts.push_back(pool.Add(to_string(i)));
+    }
+    const string long_text(100000, 'x'); // gets a block of its own
+    LiteralText long_literal = pool.Add(long_text);
+    LiteralText empty = pool.Add(""sv);
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQUAL(texts[i].Text(), to_string(i));
+    }
+    ASSERT_EQUAL(long_literal.Text(), long_text);
+    ASSERT_EQUAL(empty, LiteralText());
+
+    // Literals stay out of the process-wide symbol table and outlive the lexer through its pool
+    const size_t symbols = runtime::InternedSymbolCount();
+    Token token;
+    shared_ptr<StringPool> strings;
+    {
+        Lexer lexer("'string_pool_test literal'"sv);
+        token = lexer.CurrentToken();
+        strings = lexer.Strings();
+    }
+    ASSERT_EQUAL(token.As<token_type::String>().value.Text(), "string_pool_test literal"sv);
+    ASSERT_EQUAL(runtime::InternedSymbolCount(), symbols);
+}
+
+void TestLexemeSpans() {
+    Lexer lexer("x = 2147483647 + 'plain' + 'esc\\'aped\\t' + \"\"\n"sv);
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{2147483647}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
+    ASSERT_EQUAL(lexer.NextToken(), StringToken("plain"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
+    ASSERT_EQUAL(lexer.NextToken(), StringToken("esc'aped\t"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
+    ASSERT_EQUAL(lexer.NextToken(), StringToken(""s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+
+    for (string_view bad : {"x = 2147483648\n"sv, "x = 'unterminated\n"sv, "x = 'ends with escape\\"sv}) {
+        try {
+            Lexer bad_lexer(bad);
+            while (!bad_lexer.NextToken().Is<token_type::Eof>()) {
+            }
+            ASSERT(false);
+        } catch (const LexerError&) {
+        }
+    }
+}
+
+void TestScanKernels() {
+    string source;
+    for (int i = 0; i < 100; ++i) {
+        source += string(i % 37, ' ') + (i % 3 == 0 ? "\n"s : ""s) + string(i % 5, '\n') + "x#"s;
+    }
+    const char* end = source.data() + source.size();
+    for (const scan::Kernels* kernels : scan::Available()) {
+        for (const char* begin = source.data(); begin != end; ++begin) {
+            const char* expected_spaces = begin;
+            while (expected_spaces != end && *expected_spaces == ' ') {
+                ++expected_spaces;
+            }
+            const char* expected_blank = begin;
+            const char* expected_line_start = begin;
+            while (expected_blank != end && (*expected_blank == ' ' || *expected_blank == '\n')) {
+                if (*expected_blank++ == '\n') {
+                    expected_line_start = expected_blank;
+                }
+            }
+            const char* expected_line_end = begin;
+            while (expected_line_end != end && *expected_line_end != '\n') {
+                ++expected_line_end;
+            }
+            const string hint = kernels->name + " at "s + to_string(begin - source.data());
+            AssertEqual(kernels->skip_spaces(begin, end) - source.data(), expected_spaces - source.data(), hint);
+            const char* line_start = nullptr;
+            AssertEqual(kernels->skip_blank(begin, end, &line_start) - source.data(), expected_blank - source.data(), hint);
+            AssertEqual(line_start - source.data(), expected_line_start - source.data(), hint);
+            AssertEqual(kernels->find_line_end(begin, end) - source.data(), expected_line_end - source.data(), hint);
+        }
+    }
+}
 }  // namespace
 
 void RunOpenLexerTests(TestRunner& tr) {
@@ -367,6 +903,19 @@ void RunOpenLexerTests(TestRunner& tr) {
     RUN_TEST(tr, parse::TestMythonProgram);
     RUN_TEST(tr, parse::TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine);
     RUN_TEST(tr, parse::TestCommentsAreIgnored);
+    RUN_TEST(tr, parse::TestContiguousSources);
+    RUN_TEST(tr, parse::TestPeekToken);
+    RUN_TEST(tr, parse::TestIdsEndAtNonIdChars);
+    RUN_TEST(tr, parse::TestIndentStack);
+    RUN_TEST(tr, parse::TestTokenPositions);
+    RUN_TEST(tr, parse::TestStringPool);
+    RUN_TEST(tr, parse::TestLexemeSpans);
+    RUN_TEST(tr, parse::TestScanKernels);
+    RUN_TEST(tr, parse::TestSpscQueue);
+    RUN_TEST(tr, parse::TestPipelinedLexer);
+    RUN_TEST(tr, parse::TestSplitTopLevel);
+    RUN_TEST(tr, parse::TestParallelLexer);
+    RUN_TEST(tr, parse::TestTokenCache);
 }
 
 }  // namespace parse
\ No newline at end of file
@@ -1,10 +1,21 @@
 #include "lexer.h"
+#include "parallel_lexer.h"
 #include "parse.h"
+#include "pass_manager.h"
+#include "pipelined_lexer.h"
 #include "runtime.h"
 #include "statement.h"
 #include "test_runner_p.h"
+#include "token_cache.h"
 
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
 
 using namespace std;
 
@@ -24,15 +35,74 @@ void TestParseProgram(TestRunner& tr);
 
 namespace {
 
-    void RunMythonProgram(istream& input, ostream& output) {
-        parse::Lexer lexer(input);
-        auto program = ParseProgram(lexer);
+    // passes transform the parsed program before it runs
+    void RunParsedProgram(unique_ptr<ast::Statement> program, ostream& output, ast::PassManager& passes) {
+        passes.Run(program);
 
         runtime::SimpleContext context{output};
         runtime::Closure closure;
         program->Execute(closure, context);
     }
 
+    void RunMythonProgram(parse::TokenStream& tokens, ostream& output, ast::PassManager& passes,
+                          MethodParsing methods = MethodParsing::Eager) {
+        RunParsedProgram(ParseProgram(tokens, methods), output, passes);
+    }
+
+    void RunMythonProgram(istream& input, ostream& output) {
+        parse::Lexer lexer(input);
+        ast::PassManager passes;
+        RunMythonProgram(lexer, output, passes);
+    }
+
+    // Replaces the file at path with data through a temporary file, so a crash or a full disk never leaves a part
+    // of it behind --returns false if the file couldn't be written
+    bool WriteFileAtomically(const string& path, const string& data) {
+        const string temp_path = path + ".tmp"s;
+        {
+            ofstream out(temp_path, ios::binary);
+            out << data;
+            out.close();
+            if (!out) {
+                error_code ignored;
+                filesystem::remove(temp_path, ignored);
+                return false;
+            }
+        }
+        error_code error;
+        filesystem::rename(temp_path, path, error);
+        return !error;
+    }
+
+    // Replays tokens from cache_path if it was written for this source, otherwise lexes source and rewrites the cache
+    // A damaged cache is written again too --the header check passes a body cut short by a crash, so the replay
+    // may fail, and then the program is parsed from source before any of it runs
+    void RunWithTokenCache(string_view source, const string& cache_path, ostream& output, ast::PassManager& passes,
+                           MethodParsing methods) {
+        unique_ptr<ast::Statement> program;
+        if (filesystem::exists(cache_path)) {
+            parse::MappedFile cache(cache_path);
+            if (parse::IsTokenCacheOf(cache.Data(), source)) {
+                try {
+                    parse::TokenStreamLexer lexer(std::move(cache));
+                    program = ParseProgram(lexer, methods);
+                } catch (const parse::TokenCacheError&) {
+                }
+            }
+        }
+        if (!program) {
+            ostringstream cache;
+            parse::WriteTokenCache(source, cache);
+            if (!WriteFileAtomically(cache_path, cache.str())) { // the program still runs, only without a cache
+                cerr << "Cannot write token cache "sv << cache_path << endl;
+            }
+            istringstream replay(cache.str());
+            parse::TokenStreamLexer lexer(replay);
+            program = ParseProgram(lexer, methods);
+        }
+        RunParsedProgram(std::move(program), output, passes);
+    }
+
     void TestSimplePrints() {
         istringstream input(R"(
 print 57
@@ -111,6 +181,25 @@ print y.value
         ASSERT_EQUAL(output.str(), "2\n3\n");
     }
 
+    void TestDamagedTokenCache() {
+        const string source = "x = 'cached'\nprint x, 57\n"s;
+        const string cache_path = (filesystem::temp_directory_path() / "mython_main_test.tokens").string();
+        ostringstream cache;
+        parse::WriteTokenCache(source, cache);
+        const string full = cache.str();
+        ofstream(cache_path, ios::binary) << full.substr(0, full.size() - 5); // header is intact, body cut short
+
+        ostringstream output;
+        ast::PassManager passes;
+        RunWithTokenCache(source, cache_path, output, passes, MethodParsing::Eager);
+        ASSERT_EQUAL(output.str(), "cached 57\n"s);
+
+        ifstream rewritten(cache_path, ios::binary);
+        ASSERT_EQUAL(string(istreambuf_iterator<char>(rewritten), istreambuf_iterator<char>{}), full);
+        ASSERT(!filesystem::exists(cache_path + ".tmp"s));
+        filesystem::remove(cache_path);
+    }
+
     void TestAll() {
         TestRunner tr;
         parse::RunOpenLexerTests(tr);
@@ -123,18 +212,92 @@ print y.value
         RUN_TEST(tr, TestAssignments);
         RUN_TEST(tr, TestArithmetics);
         RUN_TEST(tr, TestVariablesArePointers);
+        RUN_TEST(tr, TestDamagedTokenCache);
     }
 
 }  // namespace
 
-int main() {
+// Usage: mython-interpreter [--pipeline | --parallel | --token-cache cache-file] [-O0 | -O1 | -O2 | --passes list]
+//                           [--pass-stats] [--lazy-methods] [source-file]
+// Program is read from the file if given --file is memory-mapped-- otherwise from stdin
+// --pipeline scans tokens on a separate thread while the program is parsed
+// --parallel scans top-level chunks of the program on all cores before it is parsed
+// --token-cache replays tokens from cache-file if the program didn't change, otherwise writes it
+// -O0 runs the program as parsed, the default; -O1 folds constants and removes dead code; -O2 also inlines small
+// methods and lowers the program into a flat node table
+// --passes runs the comma-separated passes instead, see ast::FindPass
+// --pass-stats prints the time and number of changes of each pass to stderr, also when the program fails
+// --lazy-methods parses a method body only when the method is first called
+int main(int argc, char* argv[]) {
+    ast::PassManager passes;
+    bool pass_stats = false;
     try {
         TestAll();
 
-        RunMythonProgram(cin, cout);
+        bool pipeline = false;
+        bool parallel = false;
+        MethodParsing methods = MethodParsing::Eager;
+        const char* cache_path = nullptr;
+        const char* path = nullptr;
+        // value of the option at argv[i], which must not be the last argument
+        auto option_value = [argc, argv](int& i) {
+            if (i + 1 == argc) {
+                throw invalid_argument("main(): option "s + argv[i] + " needs a value"s);
+            }
+            return argv[++i];
+        };
+        for (int i = 1; i < argc; ++i) {
+            if (argv[i] == "--pipeline"sv) {
+                pipeline = true;
+            } else if (argv[i] == "--parallel"sv) {
+                parallel = true;
+            } else if (argv[i] == "-O0"sv || argv[i] == "-O1"sv || argv[i] == "-O2"sv) {
+                passes = ast::PassManager::ForLevel(argv[i][2] - '0');
+            } else if (argv[i] == "--passes"sv) {
+                passes = ast::PassManager::FromList(option_value(i));
+            } else if (argv[i] == "--pass-stats"sv) {
+                pass_stats = true;
+            } else if (argv[i] == "--lazy-methods"sv) {
+                methods = MethodParsing::Lazy;
+            } else if (argv[i] == "--token-cache"sv) {
+                cache_path = option_value(i);
+            } else {
+                path = argv[i];
+            }
+        }
+
+        if (cache_path != nullptr) {
+            if (path != nullptr) {
+                parse::MappedFile source(path);
+                RunWithTokenCache(source.Data(), cache_path, cout, passes, methods);
+            } else {
+                string source(istreambuf_iterator<char>(cin), istreambuf_iterator<char>{});
+                RunWithTokenCache(source, cache_path, cout, passes, methods);
+            }
+        } else if (parallel) {
+            parse::ParallelLexer lexer = path != nullptr ? parse::ParallelLexer(parse::MappedFile{path})
+                                                         : parse::ParallelLexer(cin);
+            RunMythonProgram(lexer, cout, passes, methods);
+        } else if (pipeline) {
+            parse::PipelinedLexer lexer = path != nullptr ? parse::PipelinedLexer(parse::MappedFile{path})
+                                                          : parse::PipelinedLexer(cin);
+            RunMythonProgram(lexer, cout, passes, methods);
+        } else if (path != nullptr) {
+            parse::Lexer lexer(parse::MappedFile{path});
+            RunMythonProgram(lexer, cout, passes, methods);
+        } else {
+            parse::Lexer lexer(cin);
+            RunMythonProgram(lexer, cout, passes, methods);
+        }
+        if (pass_stats) {
+            passes.PrintStatistics(cerr);
+        }
     } catch (const std::exception& e) {
+        if (pass_stats) { // passes that ran before the error
+            passes.PrintStatistics(cerr);
+        }
         std::cerr << e.what() << std::endl;
         return 1;
     }
     return 0;
-}
\ No newline at end of file
+}
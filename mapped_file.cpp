@@ -0,0 +1,98 @@
+#include "mapped_file.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MYTHON_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace parse {
+
+#ifdef MYTHON_HAS_MMAP
+    MappedFile::MappedFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("MappedFile(): cannot open "s + path);
+        }
+        struct stat st{};
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("MappedFile(): cannot stat "s + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) { // mmap of zero length is an error --empty file is an empty view
+            void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("MappedFile(): cannot map "s + path);
+            }
+            madvise(addr, size_, MADV_SEQUENTIAL); // lexer reads front to back only once
+            data_ = static_cast<const char*>(addr);
+        }
+        close(fd); // mapping stays valid after the descriptor is closed
+    }
+
+    void MappedFile::Release() {
+        if (data_ != nullptr) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+    }
+#else
+    MappedFile::MappedFile(const std::string& path) {
+        ifstream file(path, ios::binary);
+        if (!file) {
+            throw std::runtime_error("MappedFile(): cannot open "s + path);
+        }
+        fallback_.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        data_ = fallback_.data();
+        size_ = fallback_.size();
+    }
+
+    void MappedFile::Release() {
+        fallback_.clear();
+        data_ = nullptr;
+        size_ = 0;
+    }
+#endif
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+            : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)),
+              fallback_(std::move(other.fallback_)) {
+        if (!fallback_.empty()) {
+            data_ = fallback_.data(); // small strings don't keep their address after move
+        }
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            Release();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            fallback_ = std::move(other.fallback_);
+            if (!fallback_.empty()) {
+                data_ = fallback_.data();
+            }
+        }
+        return *this;
+    }
+
+    MappedFile::~MappedFile() {
+        Release();
+    }
+
+    std::string_view MappedFile::Data() const {
+        return {data_, size_};
+    }
+
+}  // namespace parse
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace parse {
+
+    // Read-only memory mapping of a source file
+    // The mapped bytes live until the object is destroyed, so views over Data() are valid for its lifetime
+    class MappedFile {
+    public:
+        // Maps the whole file into memory, throws std::runtime_error if file can't be opened or mapped
+        explicit MappedFile(const std::string& path);
+
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile();
+
+        // Returns contiguous file contents --empty view for an empty file
+        [[nodiscard]] std::string_view Data() const;
+
+    private:
+        void Release();
+
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+        std::string fallback_; // file contents if platform has no mmap
+    };
+
+}  // namespace parse
@@ -0,0 +1,490 @@
+#include "optimizer.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace ast {
+
+    using runtime::ObjectHolder;
+
+    void ForEachChild(Statement& node, const function<void(unique_ptr<Statement>&)>& visit) {
+        Statement* p = &node;
+        if (auto* unary = dynamic_cast<UnaryOperation*>(p)) {
+            visit(unary->GetArgument());
+        } else if (auto* binary = dynamic_cast<BinaryOperation*>(p)) {
+            visit(binary->GetLhs());
+            visit(binary->GetRhs());
+        } else if (auto* assignment = dynamic_cast<Assignment*>(p)) {
+            visit(assignment->GetRv());
+        } else if (auto* assignment = dynamic_cast<FieldAssignment*>(p)) {
+            visit(assignment->GetRv());
+        } else if (auto* print = dynamic_cast<Print*>(p)) {
+            for (auto& arg : print->GetArgs()) {
+                visit(arg);
+            }
+        } else if (auto* call = dynamic_cast<MethodCall*>(p)) {
+            visit(call->GetObject());
+            for (auto& arg : call->GetArgs()) {
+                visit(arg);
+            }
+        } else if (auto* instance = dynamic_cast<NewInstance*>(p)) {
+            for (auto& arg : instance->GetArgs()) {
+                visit(arg);
+            }
+        } else if (auto* compound = dynamic_cast<Compound*>(p)) {
+            for (auto& statement : compound->GetStatements()) {
+                visit(statement);
+            }
+        } else if (auto* ret = dynamic_cast<Return*>(p)) {
+            visit(ret->GetStatement());
+        } else if (auto* if_else = dynamic_cast<IfElse*>(p)) {
+            visit(if_else->GetCondition());
+            visit(if_else->GetIfBody());
+            if (if_else->GetElseBody()) {
+                visit(if_else->GetElseBody());
+            }
+        } else if (auto* body = dynamic_cast<MethodBody*>(p)) {
+            visit(body->GetBody());
+        } else if (auto* lazy = dynamic_cast<LazyMethodBody*>(p)) {
+            if (lazy->IsParsed()) {
+                visit(lazy->GetBody());
+            }
+        } else if (auto* program = dynamic_cast<Program*>(p)) {
+            visit(program->GetBody());
+        } else if (auto* inlined = dynamic_cast<InlinedCall*>(p)) {
+            visit(inlined->GetCall().GetObject());
+            for (auto& arg : inlined->GetCall().GetArgs()) {
+                visit(arg);
+            }
+            visit(inlined->GetBody());
+        } else if (auto* assignment = dynamic_cast<InlinedFieldAssignment*>(p)) {
+            visit(assignment->GetObject());
+            visit(assignment->GetRv());
+        } else if (const auto* definition = dynamic_cast<ClassDefinition*>(p)) {
+            for (runtime::Method& method : definition->GetClass().TryAs<runtime::Class>()->GetOwnMethods()) {
+                visit(method.body);
+            }
+        }
+    }
+
+    namespace {
+
+        // Folded nodes are evaluated with no variables and print nothing, the stream only completes the Context
+        class FoldingContext : public runtime::Context {
+        public:
+            std::ostream& GetOutputStream() override {
+                return output_;
+            }
+
+        private:
+            ostringstream output_;
+        };
+
+        bool IsConstant(const Statement* node) {
+            return dynamic_cast<const NumericConst*>(node) != nullptr || dynamic_cast<const StringConst*>(node) != nullptr
+                   || dynamic_cast<const BoolConst*>(node) != nullptr || dynamic_cast<const None*>(node) != nullptr;
+        }
+
+        bool IsTrueConstant(Statement& constant) {
+            runtime::Closure closure;
+            FoldingContext context;
+            return runtime::IsTrue(constant.Execute(closure, context));
+        }
+
+        // Node of the value, nullptr for values that have no constant node
+        unique_ptr<Statement> MakeConstant(const ObjectHolder& value) {
+            if (!value) {
+                return make_unique<None>();
+            }
+            if (const auto* number = value.TryAs<runtime::Number>()) {
+                return make_unique<NumericConst>(*number);
+            }
+            if (const auto* str = value.TryAs<runtime::String>()) {
+                return make_unique<StringConst>(*str);
+            }
+            if (const auto* boolean = value.TryAs<runtime::Bool>()) {
+                return make_unique<BoolConst>(*boolean);
+            }
+            return nullptr;
+        }
+
+        bool IsFoldable(Statement* node) {
+            return dynamic_cast<Add*>(node) != nullptr || dynamic_cast<Sub*>(node) != nullptr
+                   || dynamic_cast<Mult*>(node) != nullptr || dynamic_cast<Div*>(node) != nullptr
+                   || dynamic_cast<Not*>(node) != nullptr || dynamic_cast<Negate*>(node) != nullptr
+                   || dynamic_cast<And*>(node) != nullptr || dynamic_cast<Or*>(node) != nullptr
+                   || dynamic_cast<Stringify*>(node) != nullptr || dynamic_cast<BuiltinComparison*>(node) != nullptr;
+        }
+
+        class ConstantFolder {
+        public:
+            size_t Fold(unique_ptr<Statement>& slot) {  // NOLINT(misc-no-recursion)
+                ForEachChild(*slot, [this](unique_ptr<Statement>& child) { Fold(child); });
+                Statement* node = slot.get();
+                if (!IsFoldable(node) || TrapsOnDivision(node)) {
+                    return changes_;
+                }
+                bool constant = true;
+                ForEachChild(*node, [&constant](unique_ptr<Statement>& child) { constant = constant && IsConstant(child.get()); });
+                if (constant || IsShortCircuit(node)) {
+                    runtime::Closure closure;
+                    FoldingContext context;
+                    try {
+                        if (auto folded = MakeConstant(node->Execute(closure, context))) {
+                            slot = std::move(folded);
+                            ++changes_;
+                        }
+                    } catch (const runtime_error&) { // left to throw when the program runs
+                    }
+                    return changes_;
+                }
+
+                if (auto* mult = dynamic_cast<Mult*>(node)) { // -x is parsed as x * -1
+                    const auto* rhs = dynamic_cast<const NumericConst*>(mult->GetRhs().get());
+                    if (rhs != nullptr && rhs->GetValue().GetValue() == -1) {
+                        slot = make_unique<Negate>(std::move(mult->GetLhs()));
+                        ++changes_;
+                    }
+                }
+                return changes_;
+            }
+
+        private:
+            // The smallest number divided by -1 is a hardware trap, not a runtime_error to catch
+            static bool TrapsOnDivision(Statement* node) {
+                auto* div = dynamic_cast<Div*>(node);
+                if (div == nullptr) {
+                    return false;
+                }
+                const auto* lhs = dynamic_cast<const NumericConst*>(div->GetLhs().get());
+                const auto* rhs = dynamic_cast<const NumericConst*>(div->GetRhs().get());
+                return lhs != nullptr && rhs != nullptr && lhs->GetValue().GetValue() == numeric_limits<int>::min()
+                       && rhs->GetValue().GetValue() == -1;
+            }
+
+            // True or x, False and x --the value is decided without evaluating x
+            static bool IsShortCircuit(Statement* node) {
+                if (auto* disjunction = dynamic_cast<Or*>(node)) {
+                    return IsConstant(disjunction->GetLhs().get()) && IsTrueConstant(*disjunction->GetLhs());
+                }
+                if (auto* conjunction = dynamic_cast<And*>(node)) {
+                    return IsConstant(conjunction->GetLhs().get()) && !IsTrueConstant(*conjunction->GetLhs());
+                }
+                return false;
+            }
+
+            size_t changes_ = 0;
+        };
+
+        // Statement after which nothing in the same Compound runs
+        bool AlwaysReturns(Statement* node) {  // NOLINT(misc-no-recursion)
+            if (dynamic_cast<Return*>(node) != nullptr) {
+                return true;
+            }
+            if (auto* if_else = dynamic_cast<IfElse*>(node)) {
+                return if_else->GetElseBody() && AlwaysReturns(if_else->GetIfBody().get())
+                       && AlwaysReturns(if_else->GetElseBody().get());
+            }
+            if (auto* compound = dynamic_cast<Compound*>(node)) {
+                auto& statements = compound->GetStatements();
+                return any_of(statements.begin(), statements.end(), [](const auto& s) { return AlwaysReturns(s.get()); });
+            }
+            return false;
+        }
+
+        class DeadCodeEliminator {
+        public:
+            size_t Eliminate(unique_ptr<Statement>& slot) {  // NOLINT(misc-no-recursion)
+                ForEachChild(*slot, [this](unique_ptr<Statement>& child) { Eliminate(child); });
+                if (auto* if_else = dynamic_cast<IfElse*>(slot.get())) {
+                    EliminateBranch(slot, *if_else);
+                } else if (auto* compound = dynamic_cast<Compound*>(slot.get())) {
+                    EliminateStatements(*compound);
+                }
+                return changes_;
+            }
+
+        private:
+            // A constant condition leaves only the live branch, an empty Compound if there is none
+            void EliminateBranch(unique_ptr<Statement>& slot, IfElse& if_else) {
+                if (IsConstant(if_else.GetCondition().get())) {
+                    unique_ptr<Statement> live = IsTrueConstant(*if_else.GetCondition()) ? std::move(if_else.GetIfBody())
+                                                                                         : std::move(if_else.GetElseBody());
+                    slot = live ? std::move(live) : make_unique<Compound>();
+                    ++changes_;
+                } else if (auto* else_body = dynamic_cast<Compound*>(if_else.GetElseBody().get());
+                           else_body != nullptr && else_body->GetStatements().empty()) {
+                    if_else.GetElseBody().reset();
+                    ++changes_;
+                }
+            }
+
+            // Nested Compounds are spliced in, empty ones vanish that way, and statements after a return are dropped
+            void EliminateStatements(Compound& compound) {
+                auto& statements = compound.GetStatements();
+                vector<unique_ptr<Statement>> live;
+                live.reserve(statements.size());
+                for (auto& statement : statements) {
+                    if (auto* nested = dynamic_cast<Compound*>(statement.get())) {
+                        for (auto& inner : nested->GetStatements()) {
+                            live.push_back(std::move(inner));
+                        }
+                        ++changes_;
+                    } else {
+                        live.push_back(std::move(statement));
+                    }
+                }
+                auto returning = find_if(live.begin(), live.end(), [](const auto& s) { return AlwaysReturns(s.get()); });
+                if (returning != live.end() && next(returning) != live.end()) {
+                    changes_ += static_cast<size_t>(live.end() - next(returning));
+                    live.erase(next(returning), live.end());
+                }
+                statements = std::move(live);
+            }
+
+            size_t changes_ = 0;
+        };
+
+        // Copy of an inlinable method body with self and params read through InlinedArgument, nullptr if the body
+        // has a node not allowed in inlined code or more nodes than budget
+        class BodySubstitution {
+        public:
+            BodySubstitution(const runtime::Method& method, size_t budget): budget_(budget) {
+                params_.push_back(runtime::Symbol("self"s));
+                params_.insert(params_.end(), method.formal_params.begin(), method.formal_params.end());
+            }
+
+            unique_ptr<Statement> Copy(Statement* node) {  // NOLINT(misc-no-recursion)
+                if (budget_ == 0) {
+                    return nullptr;
+                }
+                --budget_;
+                if (const auto* number = dynamic_cast<NumericConst*>(node)) {
+                    return make_unique<NumericConst>(number->GetValue());
+                }
+                if (const auto* str = dynamic_cast<StringConst*>(node)) {
+                    return make_unique<StringConst>(str->GetValue());
+                }
+                if (const auto* boolean = dynamic_cast<BoolConst*>(node)) {
+                    return make_unique<BoolConst>(boolean->GetValue());
+                }
+                if (dynamic_cast<None*>(node) != nullptr) {
+                    return make_unique<None>();
+                }
+                if (const auto* variable = dynamic_cast<VariableValue*>(node)) {
+                    return CopyVariable(variable->GetDottedIds());
+                }
+                if (auto* unary = dynamic_cast<UnaryOperation*>(node)) {
+                    return CopyUnary(*unary);
+                }
+                if (auto* binary = dynamic_cast<BinaryOperation*>(node)) {
+                    return CopyBinary(*binary);
+                }
+                return nullptr; // calls, assignments and control flow stay in the method
+            }
+
+            unique_ptr<Statement> CopyFieldAssignment(FieldAssignment& assignment) {
+                auto object = CopyVariable(assignment.GetObject().GetDottedIds());
+                auto rv = Copy(assignment.GetRv().get());
+                if (!object || !rv) {
+                    return nullptr;
+                }
+                return make_unique<InlinedFieldAssignment>(std::move(object), assignment.GetFieldName(), std::move(rv));
+            }
+
+        private:
+            // A method sees only self and its params. Reads of one field at most are copied: after a value that
+            // isn't an object, VariableValue looks the next name up where the previous one was found, which
+            // InlinedArgument doesn't follow. A field named like a param is refused for the same reason
+            unique_ptr<Statement> CopyVariable(const vector<runtime::Symbol>& dotted_ids) {
+                auto param = find(params_.begin(), params_.end(), dotted_ids.front());
+                if (param == params_.end() || dotted_ids.size() > 2) {
+                    return nullptr;
+                }
+                if (dotted_ids.size() == 2 && find(params_.begin(), params_.end(), dotted_ids[1]) != params_.end()) {
+                    return nullptr;
+                }
+                return make_unique<InlinedArgument>(static_cast<size_t>(param - params_.begin()),
+                                                    vector<runtime::Symbol>(dotted_ids.begin() + 1, dotted_ids.end()));
+            }
+
+            unique_ptr<Statement> CopyUnary(UnaryOperation& node) {  // NOLINT(misc-no-recursion)
+                auto argument = Copy(node.GetArgument().get());
+                if (!argument) {
+                    return nullptr;
+                }
+                if (dynamic_cast<Not*>(&node) != nullptr) {
+                    return make_unique<Not>(std::move(argument));
+                }
+                if (dynamic_cast<Negate*>(&node) != nullptr) {
+                    return make_unique<Negate>(std::move(argument));
+                }
+                if (dynamic_cast<Stringify*>(&node) != nullptr) {
+                    return make_unique<Stringify>(std::move(argument));
+                }
+                return nullptr;
+            }
+
+            unique_ptr<Statement> CopyBinary(BinaryOperation& node) {  // NOLINT(misc-no-recursion)
+                auto lhs = Copy(node.GetLhs().get());
+                auto rhs = lhs ? Copy(node.GetRhs().get()) : nullptr;
+                if (!rhs) {
+                    return nullptr;
+                }
+                if (auto* comparison = dynamic_cast<BuiltinComparison*>(&node)) {
+                    return MakeComparison(comparison->GetOp(), std::move(lhs), std::move(rhs));
+                }
+                if (dynamic_cast<Add*>(&node) != nullptr) {
+                    return make_unique<Add>(std::move(lhs), std::move(rhs));
+                }
+                if (dynamic_cast<Sub*>(&node) != nullptr) {
+                    return make_unique<Sub>(std::move(lhs), std::move(rhs));
+                }
+                if (dynamic_cast<Mult*>(&node) != nullptr) {
+                    return make_unique<Mult>(std::move(lhs), std::move(rhs));
+                }
+                if (dynamic_cast<Div*>(&node) != nullptr) {
+                    return make_unique<Div>(std::move(lhs), std::move(rhs));
+                }
+                if (dynamic_cast<Or*>(&node) != nullptr) {
+                    return make_unique<Or>(std::move(lhs), std::move(rhs));
+                }
+                if (dynamic_cast<And*>(&node) != nullptr) {
+                    return make_unique<And>(std::move(lhs), std::move(rhs));
+                }
+                return nullptr; // a Comparison with an arbitrary comparator
+            }
+
+            static unique_ptr<Statement> MakeComparison(runtime::CompareOp op, unique_ptr<Statement> lhs,
+                                                        unique_ptr<Statement> rhs) {
+                using runtime::CompareOp;
+                switch (op) {
+                    case CompareOp::Equal:
+                        return make_unique<ComparisonOf<CompareOp::Equal>>(std::move(lhs), std::move(rhs));
+                    case CompareOp::NotEqual:
+                        return make_unique<ComparisonOf<CompareOp::NotEqual>>(std::move(lhs), std::move(rhs));
+                    case CompareOp::Less:
+                        return make_unique<ComparisonOf<CompareOp::Less>>(std::move(lhs), std::move(rhs));
+                    case CompareOp::Greater:
+                        return make_unique<ComparisonOf<CompareOp::Greater>>(std::move(lhs), std::move(rhs));
+                    case CompareOp::LessOrEqual:
+                        return make_unique<ComparisonOf<CompareOp::LessOrEqual>>(std::move(lhs), std::move(rhs));
+                    case CompareOp::GreaterOrEqual:
+                        return make_unique<ComparisonOf<CompareOp::GreaterOrEqual>>(std::move(lhs), std::move(rhs));
+                }
+                return nullptr;
+            }
+
+            vector<runtime::Symbol> params_;
+            size_t budget_;
+        };
+
+        class Inliner {
+        public:
+            size_t Inline(unique_ptr<Statement>& tree) {
+                CollectMethods(*tree);
+                Rewrite(tree);
+                return changes_;
+            }
+
+        private:
+            // Nodes an inlined body may have, operators and operands together
+            static constexpr size_t BODY_BUDGET = 16;
+
+            struct Candidate {
+                const runtime::Class* cls = nullptr;
+                const runtime::Method* method = nullptr;
+                int definitions = 0; // classes defining a method of this name and arity
+            };
+
+            // Own methods of every class the program defines, by name and arity
+            void CollectMethods(Statement& node) {  // NOLINT(misc-no-recursion)
+                if (const auto* definition = dynamic_cast<ClassDefinition*>(&node)) {
+                    auto* cls = definition->GetClass().TryAs<runtime::Class>();
+                    for (const runtime::Method& method : cls->GetOwnMethods()) {
+                        Candidate& candidate = candidates_[{method.name, method.formal_params.size()}];
+                        candidate.cls = cls;
+                        candidate.method = &method;
+                        ++candidate.definitions;
+                    }
+                }
+                ForEachChild(node, [this](unique_ptr<Statement>& child) { CollectMethods(*child); });
+            }
+
+            void Rewrite(unique_ptr<Statement>& slot) {  // NOLINT(misc-no-recursion)
+                ForEachChild(*slot, [this](unique_ptr<Statement>& child) { Rewrite(child); });
+                auto* call = dynamic_cast<MethodCall*>(slot.get());
+                if (call == nullptr || call->GetArgs().size() > InlinedCall::MAX_PARAMS) {
+                    return;
+                }
+                auto it = candidates_.find({call->GetMethod(), call->GetArgs().size()});
+                // a name defined by several classes is called polymorphically, no single body fits
+                if (it == candidates_.end() || it->second.definitions != 1) {
+                    return;
+                }
+                auto [body, returns_value] = Substitute(*it->second.method);
+                if (!body) {
+                    return;
+                }
+                unique_ptr<MethodCall> original(static_cast<MethodCall*>(slot.release()));
+                slot = make_unique<InlinedCall>(std::move(original), *it->second.cls, std::move(body), returns_value);
+                ++changes_;
+            }
+
+            // Bodies of one statement: return of an expression, or a field assignment that returns None
+            static pair<unique_ptr<Statement>, bool> Substitute(const runtime::Method& method) {
+                auto* body = dynamic_cast<MethodBody*>(method.body.get());
+                auto* compound = body != nullptr ? dynamic_cast<Compound*>(body->GetBody().get()) : nullptr;
+                if (compound == nullptr || compound->GetStatements().size() != 1) {
+                    return {};
+                }
+                Statement* statement = compound->GetStatements().front().get();
+                BodySubstitution substitution(method, BODY_BUDGET);
+                if (auto* ret = dynamic_cast<Return*>(statement)) {
+                    return {substitution.Copy(ret->GetStatement().get()), true};
+                }
+                if (auto* assignment = dynamic_cast<FieldAssignment*>(statement)) {
+                    return {substitution.CopyFieldAssignment(*assignment), false};
+                }
+                return {};
+            }
+
+            map<pair<runtime::Symbol, size_t>, Candidate> candidates_;
+            size_t changes_ = 0;
+        };
+
+    }  // namespace
+
+    size_t FoldConstants(unique_ptr<Statement>& tree) {
+        // folded nodes go to the program's arena, like the ones they replace
+        optional<runtime::Arena::Scope> scope;
+        if (auto* program = dynamic_cast<Program*>(tree.get())) {
+            scope.emplace(program->GetArena());
+        }
+        return ConstantFolder().Fold(tree);
+    }
+
+    size_t EliminateDeadCode(unique_ptr<Statement>& tree) {
+        optional<runtime::Arena::Scope> scope; // for the empty Compounds that stand in for removed branches
+        if (auto* program = dynamic_cast<Program*>(tree.get())) {
+            scope.emplace(program->GetArena());
+        }
+        return DeadCodeEliminator().Eliminate(tree);
+    }
+
+    size_t InlineMethods(unique_ptr<Statement>& tree) {
+        optional<runtime::Arena::Scope> scope; // substituted bodies go to the program's arena
+        if (auto* program = dynamic_cast<Program*>(tree.get())) {
+            scope.emplace(program->GetArena());
+        }
+        return Inliner().Inline(tree);
+    }
+
+}  // namespace ast
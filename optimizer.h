@@ -0,0 +1,35 @@
+#pragma once
+
+#include "statement.h"
+
+#include <functional>
+#include <memory>
+
+namespace ast {
+
+    // Calls visit for every child slot of node --a pass may replace the child in it. Children of ClassDefinition
+    // are the bodies of its class's own methods, the else body of IfElse is skipped when there is none, a
+    // LazyMethodBody not parsed yet has no children
+    void ForEachChild(Statement& node, const std::function<void(std::unique_ptr<Statement>&)>& visit);
+
+    // Optimization passes over a parsed program --each rewrites tree in place, method bodies of the classes it
+    // defines included, and returns the number of changes made
+
+    // Replaces Add, Sub, Mult, Div, Not, Negate, And, Or, Stringify and builtin comparisons of constants with the
+    // constant they evaluate to, and rewrites the parser's x * -1 into Negate. Operations that throw, like division
+    // by zero, are kept to throw at runtime
+    size_t FoldConstants(std::unique_ptr<Statement>& tree);
+
+    // Drops statements that follow a return in the same Compound, replaces an IfElse with a constant condition by
+    // its live branch and splices nested Compounds into the enclosing one, so empty ones disappear. Best run after
+    // FoldConstants, which makes conditions constant
+    size_t EliminateDeadCode(std::unique_ptr<Statement>& tree);
+
+    // Replaces calls of small methods with InlinedCall holding a copy of the method's body. A method is inlined if its
+    // body is a single return of an expression or a single field assignment, it has at most InlinedCall::MAX_PARAMS
+    // params and it is the only method of its name and arity in the classes the program defines. Inlined bodies make
+    // no method calls of their own, but their operators may still call __add__, __eq__, __lt__ or __str__ of an
+    // object, which may run the same inlined code again --each InlinedCall puts back the arguments it found
+    size_t InlineMethods(std::unique_ptr<Statement>& tree);
+
+}  // namespace ast
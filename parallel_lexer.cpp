@@ -0,0 +1,215 @@
+#include "parallel_lexer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <iterator>
+#include <thread>
+
+using namespace std;
+
+namespace parse {
+
+    namespace {
+        bool IsElseLine(string_view line) {
+            return line.substr(0, 4) == "else"sv
+                   && (line.size() == 4 || (!isalnum(static_cast<unsigned char>(line[4])) && line[4] != '_'));
+        }
+
+        // Blank and comment lines are skipped by the lexer without measuring indent --a block may go on after them
+        bool StartsStatement(string_view line) {
+            char first = line.front();
+            return first != ' ' && first != '\n' && first != '#' && !IsElseLine(line);
+        }
+
+        // Returns start of the first top-level statement line after position from or source size
+        size_t FindStatementStart(string_view source, size_t from) {
+            while (true) {
+                size_t line_end = source.find('\n', from);
+                if (line_end == string_view::npos) {
+                    return source.size();
+                }
+                size_t line_start = line_end + 1;
+                if (line_start == source.size()) {
+                    return line_start;
+                }
+                if (StartsStatement(source.substr(line_start))) {
+                    return line_start;
+                }
+                from = line_start;
+            }
+        }
+    }  // namespace
+
+    std::vector<std::string_view> SplitTopLevel(std::string_view source, size_t max_chunks, size_t min_chunk_size) {
+        size_t count = std::clamp<size_t>(source.size() / std::max<size_t>(min_chunk_size, 1), 1, std::max<size_t>(max_chunks, 1));
+        vector<string_view> chunks;
+        size_t begin = 0;
+        for (size_t i = 1; i < count; ++i) {
+            size_t split = FindStatementStart(source, std::max(begin, source.size() / count * i));
+            if (split >= source.size()) {
+                break;
+            }
+            chunks.push_back(source.substr(begin, split - begin));
+            begin = split;
+        }
+        chunks.push_back(source.substr(begin));
+        return chunks;
+    }
+
+    std::vector<std::string_view> SplitStatements(std::string_view source) {
+        vector<string_view> parts;
+        StatementCutter cutter;
+        size_t begin = 0; // leading blank and comment lines are a part of their own
+        while (optional<size_t> cut = cutter.NextCut(source, true)) {
+            parts.push_back(source.substr(begin, *cut - begin));
+            begin = *cut;
+        }
+        parts.push_back(source.substr(begin));
+        return parts;
+    }
+
+    std::optional<size_t> StatementCutter::NextCut(std::string_view source, bool at_end) {
+        for (; pos_ < source.size(); ++pos_) {
+            if (line_start_) {
+                if (!at_end && source.size() - pos_ < kLookahead) {
+                    return nullopt; // the line may turn out to be else
+                }
+                line_start_ = false;
+                if (StartsStatement(source.substr(pos_))) {
+                    return pos_;
+                }
+            }
+            char c = source[pos_];
+            if (quote_ != 0) { // string may span lines, ends at the same quote, backslash escapes one char
+                if (escape_) {
+                    escape_ = false;
+                } else if (c == '\\') {
+                    escape_ = true;
+                } else if (c == quote_) {
+                    quote_ = 0;
+                }
+            } else if (comment_) { // comment runs to the end of line, quotes in it mean nothing
+                comment_ = c != '\n';
+                line_start_ = c == '\n';
+            } else if (c == '#') {
+                comment_ = true;
+            } else if (c == '\'' || c == '"') {
+                quote_ = c;
+            } else {
+                line_start_ = c == '\n';
+            }
+        }
+        return nullopt;
+    }
+
+    void StatementCutter::Drop(size_t count) {
+        pos_ -= count;
+    }
+
+    ParallelLexer::ParallelLexer(std::istream& input, size_t threads, size_t min_chunk_size)
+            : input_data_(istreambuf_iterator<char>(input), istreambuf_iterator<char>()) {
+        Tokenize(input_data_, threads, min_chunk_size);
+    }
+
+    ParallelLexer::ParallelLexer(std::string_view source, size_t threads, size_t min_chunk_size) {
+        Tokenize(source, threads, min_chunk_size);
+    }
+
+    ParallelLexer::ParallelLexer(MappedFile file, size_t threads, size_t min_chunk_size): file_(std::move(file)) {
+        Tokenize(file_->Data(), threads, min_chunk_size);
+    }
+
+    void ParallelLexer::Tokenize(std::string_view source, size_t threads, size_t min_chunk_size) {
+        if (threads == 0) {
+            threads = std::max(thread::hardware_concurrency(), 1u);
+        }
+        const char* counted = source.data();
+        uint32_t line = 1;
+        for (string_view part : SplitTopLevel(source, threads, min_chunk_size)) {
+            line += static_cast<uint32_t>(std::count(counted, part.data(), '\n'));
+            counted = part.data();
+            chunks_.push_back({part, {}, nullptr, nullptr, line});
+        }
+
+        atomic<size_t> next{0};
+        auto work = [this, &next] {
+            for (size_t i = next++; i < chunks_.size(); i = next++) {
+                TokenizeChunk(chunks_[i], i + 1 == chunks_.size());
+            }
+        };
+        vector<thread> workers;
+        for (size_t i = 1; i < std::min(threads, chunks_.size()); ++i) {
+            workers.emplace_back(work);
+        }
+        work(); // calling thread takes chunks too
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        // A chunk before the last one fails if its end was inside a multi-line string --or on a real error
+        // Chunks before it started outside strings, so the rest is scanned again serially from its start
+        for (size_t i = 0; i + 1 < chunks_.size(); ++i) {
+            if (chunks_[i].error) {
+                Chunk rest{string_view(chunks_[i].source.data(), source.data() + source.size() - chunks_[i].source.data()),
+                           {}, nullptr, nullptr, chunks_[i].first_line};
+                TokenizeChunk(rest, true);
+                chunks_.resize(i);
+                chunks_.push_back(std::move(rest));
+                break;
+            }
+        }
+        SkipFinishedChunks(); // first token is ready after construction, same as with Lexer
+    }
+
+    void ParallelLexer::TokenizeChunk(Chunk& chunk, bool keep_eof) {
+        runtime::LocalSymbolTable names; // workers share no lock while they scan
+        try {
+            Lexer lexer(chunk.source, names);
+            chunk.strings = lexer.Strings();
+            while (!lexer.CurrentToken().Is<token_type::Eof>()) {
+                Token& token = chunk.tokens.emplace_back(lexer.CurrentToken());
+                token.SetPosition(token.Line() + chunk.first_line - 1, token.Column());
+                lexer.NextToken();
+            }
+            if (keep_eof) {
+                chunk.tokens.emplace_back(token_type::Eof{});
+            }
+        } catch (...) {
+            chunk.error = current_exception();
+            chunk.tokens.emplace_back(token_type::Eof{}); // stream stays at Eof after the error is thrown
+        }
+
+        vector<runtime::Symbol> symbols = names.Merge(); // one lock for all names of the chunk
+        for (Token& token : chunk.tokens) {
+            if (const auto* id = token.TryAs<token_type::Id>()) {
+                token.emplace(token_type::Id{symbols[id->value.Id()]});
+            }
+        }
+    }
+
+    void ParallelLexer::SkipFinishedChunks() {
+        while (token_ == chunks_[chunk_].tokens.size()) {
+            ++chunk_; // only the last or a failed chunk ends with Eof, so the stream never runs past them
+            token_ = 0;
+        }
+        const Chunk& chunk = chunks_[chunk_];
+        if (chunk.error && token_ + 1 == chunk.tokens.size()) { // reached the token that failed
+            rethrow_exception(chunk.error);
+        }
+    }
+
+    const Token& ParallelLexer::CurrentToken() const {
+        return chunks_[chunk_].tokens[token_];
+    }
+
+    const Token& ParallelLexer::NextToken() {
+        if (CurrentToken().Is<token_type::Eof>()) {
+            return CurrentToken();
+        }
+        ++token_;
+        SkipFinishedChunks();
+        return CurrentToken();
+    }
+
+}  // namespace parse
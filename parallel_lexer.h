@@ -0,0 +1,94 @@
+#pragma once
+
+#include "lexer.h"
+
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace parse {
+
+    // Splits source into about max_chunks parts of at least min_chunk_size bytes
+    // Every part but the first starts at a column-0 line that begins a top-level statement --
+    // not blank, not a comment, not else-- so each part can be scanned by its own Lexer
+    // A split may fall inside a multi-line string literal, ParallelLexer detects and repairs it
+    std::vector<std::string_view> SplitTopLevel(std::string_view source, size_t max_chunks, size_t min_chunk_size);
+
+    // Splits source before every column-0 line that starts a top-level statement
+    // Unlike SplitTopLevel it scans all the source, tracking string literals and comments the same way Lexer does,
+    // so a part never starts inside them
+    std::vector<std::string_view> SplitStatements(std::string_view source);
+
+    // Finds the places SplitStatements cuts at in a source that arrives in pieces
+    // Scanning resumes where the previous call stopped, so every char is looked at once
+    class StatementCutter {
+    public:
+        // Returns the next statement start in source after the previous one, nullopt if there is none yet
+        // source must begin with the text passed before, at_end tells no more text will follow
+        std::optional<size_t> NextCut(std::string_view source, bool at_end);
+
+        // Forgets the first count chars of source, which the caller has dropped --count must be a returned cut
+        void Drop(size_t count);
+
+    private:
+        static constexpr size_t kLookahead = 5; // chars of a line that tell else from else_ and the like
+
+        size_t pos_ = 0; // next char to scan
+        char quote_ = 0; // quote of the string literal pos_ is in, 0 outside strings
+        bool escape_ = false; // previous char in the string was a backslash
+        bool comment_ = false;
+        bool line_start_ = false; // pos_ starts a line outside strings --the source start is never a cut
+    };
+
+    // Token stream scanned up front by several Lexers at once, one per top-level chunk of the source
+    // Chunk seams need no stitching: a chunk lexer closes all blocks at its end with the same
+    // Newline and Dedent tokens the serial lexer emits before a column-0 line, only its Eof is dropped
+    // Chunk lexers intern names in tables of their own, each merged into the process-wide one with a single lock
+    // when its chunk is scanned, so workers don't serialize on the symbol table
+    // Tokens are the same as parse::Lexer gives, lexer errors are thrown when the stream reaches them
+    class ParallelLexer : public TokenStream {
+    public:
+        // threads == 0 means one thread per hardware core
+        explicit ParallelLexer(std::istream& input, size_t threads = 0, size_t min_chunk_size = kMinChunkSize);
+
+        // Scans caller-owned contiguous source --source must outlive the lexer
+        explicit ParallelLexer(std::string_view source, size_t threads = 0, size_t min_chunk_size = kMinChunkSize);
+
+        explicit ParallelLexer(MappedFile file, size_t threads = 0, size_t min_chunk_size = kMinChunkSize);
+
+        ParallelLexer(const ParallelLexer&) = delete;
+        ParallelLexer& operator=(const ParallelLexer&) = delete;
+
+        [[nodiscard]] const Token& CurrentToken() const override;
+
+        // Returned references stay valid for the lexer lifetime
+        const Token& NextToken() override;
+
+        // Smaller sources aren't worth a thread
+        static constexpr size_t kMinChunkSize = 64 * 1024;
+
+    private:
+        struct Chunk {
+            std::string_view source;
+            std::vector<Token> tokens;
+            std::shared_ptr<StringPool> strings; // texts of the chunk's String tokens, kept from its lexer
+            std::exception_ptr error; // thrown when the stream reaches Eof that closes a failed chunk
+            uint32_t first_line = 1; // line of the source the chunk starts at --chunk lexers count from 1
+        };
+
+        void Tokenize(std::string_view source, size_t threads, size_t min_chunk_size);
+        static void TokenizeChunk(Chunk& chunk, bool keep_eof);
+        void SkipFinishedChunks(); // moves to the chunk holding the current token, throws chunk's error at its end
+
+        std::string input_data_; // owned source if lexer was built from a stream
+        std::optional<MappedFile> file_; // owned source if lexer was built from a file
+        std::vector<Chunk> chunks_;
+        size_t chunk_ = 0; // chunk of the current token
+        size_t token_ = 0; // current token in the chunk
+    };
+
+}  // namespace parse
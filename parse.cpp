@@ -3,11 +3,17 @@
 #include "lexer.h"
 #include "statement.h"
 
+#include <array>
+#include <optional>
+#include <unordered_map>
+
 using namespace std;
 
 namespace TokenType = parse::token_type;
 
 namespace {
+    const runtime::Symbol STR_FUNCTION{"str"};
+
     bool operator==(const parse::Token& token, char c) {
         const auto* p = token.TryAs<TokenType::Char>();
         return p != nullptr && p->value == c;
@@ -17,10 +23,87 @@ namespace {
         return !(token == c);
     }
 
+    // Binary operators of expressions, a higher precedence binds tighter
+    // All of them are left-associative except comparisons, which don't chain
+    constexpr int OR_PRECEDENCE = 1;
+    constexpr int AND_PRECEDENCE = 2;
+    constexpr int NOT_PRECEDENCE = 3; // operand of prefix not is a comparison or anything tighter
+    constexpr int COMPARISON_PRECEDENCE = 4;
+    constexpr int ADDITIVE_PRECEDENCE = 5;
+    constexpr int MULTIPLICATIVE_PRECEDENCE = 6;
+
+    using runtime::CompareOp;
+
+    using BinaryBuilder = unique_ptr<ast::Statement> (*)(unique_ptr<ast::Statement>, unique_ptr<ast::Statement>);
+
+    struct BinaryOperator {
+        int precedence = 0; // 0 --token isn't a binary operator
+        BinaryBuilder build = nullptr;
+    };
+
+    template <typename Node>
+    unique_ptr<ast::Statement> MakeBinary(unique_ptr<ast::Statement> lhs, unique_ptr<ast::Statement> rhs) {
+        return make_unique<Node>(std::move(lhs), std::move(rhs));
+    }
+
+    template <CompareOp op>
+    unique_ptr<ast::Statement> MakeComparison(unique_ptr<ast::Statement> lhs, unique_ptr<ast::Statement> rhs) {
+        return make_unique<ast::ComparisonOf<op>>(std::move(lhs), std::move(rhs));
+    }
+
+    // Operators spelled as keywords or two-char lexemes, by token kind
+    constexpr auto KIND_OPERATORS = [] {
+        array<BinaryOperator, parse::TokenTypes::size> table{};
+        table[parse::TOKEN_KIND<TokenType::Or>] = {OR_PRECEDENCE, MakeBinary<ast::Or>};
+        table[parse::TOKEN_KIND<TokenType::And>] = {AND_PRECEDENCE, MakeBinary<ast::And>};
+        table[parse::TOKEN_KIND<TokenType::Eq>] = {COMPARISON_PRECEDENCE, MakeComparison<CompareOp::Equal>};
+        table[parse::TOKEN_KIND<TokenType::NotEq>] = {COMPARISON_PRECEDENCE, MakeComparison<CompareOp::NotEqual>};
+        table[parse::TOKEN_KIND<TokenType::LessOrEq>] = {COMPARISON_PRECEDENCE, MakeComparison<CompareOp::LessOrEqual>};
+        table[parse::TOKEN_KIND<TokenType::GreaterOrEq>] = {COMPARISON_PRECEDENCE, MakeComparison<CompareOp::GreaterOrEqual>};
+        return table;
+    }();
+
+    // Single-char operators, by char
+    constexpr auto CHAR_OPERATORS = [] {
+        array<BinaryOperator, 128> table{};
+        table['<'] = {COMPARISON_PRECEDENCE, MakeComparison<CompareOp::Less>};
+        table['>'] = {COMPARISON_PRECEDENCE, MakeComparison<CompareOp::Greater>};
+        table['+'] = {ADDITIVE_PRECEDENCE, MakeBinary<ast::Add>};
+        table['-'] = {ADDITIVE_PRECEDENCE, MakeBinary<ast::Sub>};
+        table['*'] = {MULTIPLICATIVE_PRECEDENCE, MakeBinary<ast::Mult>};
+        table['/'] = {MULTIPLICATIVE_PRECEDENCE, MakeBinary<ast::Div>};
+        return table;
+    }();
+
+    const BinaryOperator& FindBinaryOperator(const parse::Token& token) {
+        if (const auto* ch = token.TryAs<TokenType::Char>()) {
+            auto index = static_cast<unsigned char>(ch->value);
+            return CHAR_OPERATORS[index < CHAR_OPERATORS.size() ? index : 0];
+        }
+        return KIND_OPERATORS[token.Kind()];
+    }
+
+    // Classes declared so far with their number in declaration order --a lazily parsed method body may refer
+    // only to the classes numbered below the count the history had when the body was scanned
+    using ClassHistory = unordered_map<runtime::Symbol, pair<const runtime::Class*, size_t>>;
+
     class Parser {
     public:
-        explicit Parser(parse::Lexer& lexer)
-                : lexer_(lexer) {
+        Parser(parse::TokenStream& lexer, runtime::Closure& declared_classes, MethodParsing methods)
+                : lexer_(lexer), declared_classes_(declared_classes), methods_(methods) {
+            if (methods_ == MethodParsing::Lazy) {
+                history_ = make_shared<ClassHistory>();
+                for (const auto& [name, cls] : declared_classes_) {
+                    history_->emplace(name, pair{cls.TryAs<runtime::Class>(), history_->size()});
+                }
+            }
+        }
+
+        // Parser of a lazy method body, which sees the first visible_classes classes of history
+        Parser(parse::TokenStream& lexer, runtime::Closure& declared_classes, shared_ptr<ClassHistory> history,
+               optional<size_t> visible_classes)
+                : lexer_(lexer), declared_classes_(declared_classes), methods_(MethodParsing::Lazy),
+                  history_(std::move(history)), visible_classes_(visible_classes) {
         }
 
         // Program -> eps
@@ -76,17 +159,82 @@ namespace {
                 lexer_.ExpectNext<TokenType::Char>(':');
                 lexer_.NextToken();
 
-                m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
+                if (methods_ == MethodParsing::Lazy) {
+                    m.body = ScanMethodBody();
+                } else {
+                    m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
+                }
 
                 result.push_back(std::move(m));
             }
             return result;
         }
 
+        // Copies the tokens of a suite up to its closing Dedent, the body is parsed from them on the first call
+        // A body that declares a class is parsed right away: later statements of the program may use the class
+        unique_ptr<ast::Statement> ScanMethodBody()  // NOLINT
+        {
+            auto tokens = make_shared<vector<parse::Token>>();
+            tokens->push_back(lexer_.CurrentToken());
+            lexer_.Expect<TokenType::Newline>();
+            tokens->push_back(lexer_.NextToken());
+            lexer_.Expect<TokenType::Indent>();
+
+            bool parse_now = false;
+            for (int depth = 1; depth > 0;) {
+                const parse::Token& token = lexer_.NextToken();
+                if (token.Is<TokenType::Eof>()) { // the suite isn't closed, parsing it reports the error
+                    parse_now = true;
+                    break;
+                }
+                parse::Token& copy = tokens->emplace_back(token);
+                if (const auto* str = token.TryAs<TokenType::String>()) { // the stream's pool may be gone by the first call
+                    if (!body_strings_) {
+                        body_strings_ = make_shared<parse::StringPool>();
+                    }
+                    copy.emplace(TokenType::String{body_strings_->Add(str->value.Text())});
+                }
+                if (token.Is<TokenType::Indent>()) {
+                    ++depth;
+                } else if (token.Is<TokenType::Dedent>()) {
+                    --depth;
+                } else if (token.Is<TokenType::Class>()) {
+                    parse_now = true;
+                }
+            }
+            lexer_.NextToken();
+
+            if (parse_now) {
+                parse::TokenReplay replay(*tokens);
+                Parser parser(replay, declared_classes_, history_, visible_classes_);
+                return make_unique<ast::MethodBody>(parser.ParseSuite());
+            }
+            // strings is unused by the body, it keeps the texts of the String tokens alive
+            return make_unique<ast::LazyMethodBody>(
+                    [tokens, strings = body_strings_, history = history_, visible = history_->size(),
+                     arena = runtime::Arena::Current()] {
+                        runtime::Arena::Scope scope(arena);
+                        parse::TokenReplay replay(*tokens);
+                        runtime::Closure no_classes; // a body declaring classes is never lazy
+                        Parser parser(replay, no_classes, history, visible);
+                        return make_unique<ast::MethodBody>(parser.ParseSuite());
+                    });
+        }
+
+        // Class named name that the statement being parsed may refer to, nullptr if there is none
+        [[nodiscard]] const runtime::Class* FindClass(runtime::Symbol name) const {
+            if (visible_classes_) {
+                auto it = history_->find(name);
+                return it != history_->end() && it->second.second < *visible_classes_ ? it->second.first : nullptr;
+            }
+            auto it = declared_classes_.find(name);
+            return it != declared_classes_.end() ? it->second.TryAs<runtime::Class>() : nullptr;
+        }
+
         // ClassDefinition -> Id ['(' Id ')'] : new_line indent MethodList dedent
         unique_ptr<ast::Statement> ParseClassDefinition()  // NOLINT
         {
-            string class_name = lexer_.Expect<TokenType::Id>().value;
+            runtime::Symbol class_name = lexer_.Expect<TokenType::Id>().value;
 
             lexer_.NextToken();
 
@@ -96,11 +244,10 @@ namespace {
                 lexer_.ExpectNext<TokenType::Char>(')');
                 lexer_.NextToken();
 
-                auto it = declared_classes_.find(name);
-                if (it == declared_classes_.end()) {
-                    throw ParseError("Base class "s + name + " not found for class "s + class_name);
+                base_class = FindClass(name);
+                if (base_class == nullptr) {
+                    throw ParseError("Base class "s + string(name.Name()) + " not found for class "s + string(class_name.Name()));
                 }
-                base_class = static_cast<const runtime::Class*>(it->second.Get());  // NOLINT
             }
 
             lexer_.Expect<TokenType::Char>(':');
@@ -114,18 +261,21 @@ namespace {
 
             auto [it, inserted] = declared_classes_.insert({
                                                                    class_name,
-                                                                   runtime::ObjectHolder::Own(runtime::Class(class_name, std::move(methods), base_class)),
+                                                                   runtime::ObjectHolder::Own(runtime::Class(string(class_name.Name()), std::move(methods), base_class)),
                                                            });
 
             if (!inserted) {
-                throw ParseError("Class "s + class_name + " already exists"s);
+                throw ParseError("Class "s + string(class_name.Name()) + " already exists"s);
+            }
+            if (history_) {
+                history_->emplace(class_name, pair{it->second.TryAs<runtime::Class>(), history_->size()});
             }
 
             return make_unique<ast::ClassDefinition>(it->second);
         }
 
-        vector<string> ParseDottedIds() {
-            vector<string> result(1, lexer_.Expect<TokenType::Id>().value);
+        vector<runtime::Symbol> ParseDottedIds() {
+            vector<runtime::Symbol> result(1, lexer_.Expect<TokenType::Id>().value);
 
             while (lexer_.NextToken() == '.') {
                 result.push_back(lexer_.ExpectNext<TokenType::Id>().value);
@@ -139,24 +289,24 @@ namespace {
         unique_ptr<ast::Statement> ParseAssignmentOrCall() {
             lexer_.Expect<TokenType::Id>();
 
-            vector<string> id_list = ParseDottedIds();
-            string last_name = id_list.back();
+            vector<runtime::Symbol> id_list = ParseDottedIds();
+            runtime::Symbol last_name = id_list.back();
             id_list.pop_back();
 
             if (lexer_.CurrentToken() == '=') {
                 lexer_.NextToken();
 
                 if (id_list.empty()) {
-                    return make_unique<ast::Assignment>(std::move(last_name), ParseTest());
+                    return make_unique<ast::Assignment>(last_name, ParseTest());
                 }
                 return make_unique<ast::FieldAssignment>(ast::VariableValue{std::move(id_list)},
-                                                         std::move(last_name), ParseTest());
+                                                         last_name, ParseTest());
             }
             lexer_.Expect<TokenType::Char>('(');
             lexer_.NextToken();
 
             if (id_list.empty()) {
-                throw ParseError("Mython doesn't support functions, only methods: "s + last_name);
+                throw ParseError("Mython doesn't support functions, only methods: "s + string(last_name.Name()));
             }
 
             vector<unique_ptr<ast::Statement>> args;
@@ -167,53 +317,19 @@ namespace {
             lexer_.NextToken();
 
             return make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(id_list)),
-                                                std::move(last_name), std::move(args));
-        }
-
-        // Expr -> Adder ['+'/'-' Adder]*
-        unique_ptr<ast::Statement> ParseExpression()  // NOLINT
-        {
-            unique_ptr<ast::Statement> result = ParseAdder();
-            while (lexer_.CurrentToken() == '+' || lexer_.CurrentToken() == '-') {
-                char op = lexer_.CurrentToken().As<TokenType::Char>().value;
-                lexer_.NextToken();
-
-                if (op == '+') {
-                    result = make_unique<ast::Add>(std::move(result), ParseAdder());
-                } else {
-                    result = make_unique<ast::Sub>(std::move(result), ParseAdder());
-                }
-            }
-            return result;
+                                                last_name, std::move(args));
         }
 
-        // Adder -> Mult ['*'/'/' Mult]*
-        unique_ptr<ast::Statement> ParseAdder()  // NOLINT
-        {
-            unique_ptr<ast::Statement> result = ParseMult();
-            while (lexer_.CurrentToken() == '*' || lexer_.CurrentToken() == '/') {
-                char op = lexer_.CurrentToken().As<TokenType::Char>().value;
-                lexer_.NextToken();
-
-                if (op == '*') {
-                    result = make_unique<ast::Mult>(std::move(result), ParseMult());
-                } else {
-                    result = make_unique<ast::Div>(std::move(result), ParseMult());
-                }
-            }
-            return result;
-        }
-
-        // Mult -> '(' Expr ')'
-        //       | NUMBER
-        //       | '-' Mult
-        //       | STRING
-        //       | NONE
-        //       | TRUE
-        //       | FALSE
-        //       | DottedIds '(' ExprList ')'
-        //       | DottedIds
-        unique_ptr<ast::Statement> ParseMult()  // NOLINT
+        // Primary -> '(' Test ')'
+        //          | NUMBER
+        //          | '-' Primary
+        //          | STRING
+        //          | NONE
+        //          | TRUE
+        //          | FALSE
+        //          | DottedIds '(' TestList ')'
+        //          | DottedIds
+        unique_ptr<ast::Statement> ParsePrimary()  // NOLINT
         {
             if (lexer_.CurrentToken() == '(') {
                 lexer_.NextToken();
@@ -224,7 +340,7 @@ namespace {
             }
             if (lexer_.CurrentToken() == '-') {
                 lexer_.NextToken();
-                return make_unique<ast::Mult>(ParseMult(), make_unique<ast::NumericConst>(-1));
+                return make_unique<ast::Mult>(ParsePrimary(), make_unique<ast::NumericConst>(-1));
             }
             if (const auto* num = lexer_.CurrentToken().TryAs<TokenType::Number>()) {
                 int result = num->value;
@@ -232,7 +348,7 @@ namespace {
                 return make_unique<ast::NumericConst>(result);
             }
             if (const auto* str = lexer_.CurrentToken().TryAs<TokenType::String>()) {
-                string result = str->value;
+                string result(str->value.Text());
                 lexer_.NextToken();
                 return make_unique<ast::StringConst>(std::move(result));
             }
@@ -253,7 +369,7 @@ namespace {
         }
 
         std::unique_ptr<ast::Statement> ParseDottedIdsInMultExpr() {
-            vector<string> names = ParseDottedIds();
+            vector<runtime::Symbol> names = ParseDottedIds();
 
             if (lexer_.CurrentToken() == '(') {
                 // various calls
@@ -264,25 +380,24 @@ namespace {
                 lexer_.Expect<TokenType::Char>(')');
                 lexer_.NextToken();
 
-                auto method_name = names.back();
+                runtime::Symbol method_name = names.back();
                 names.pop_back();
 
                 if (!names.empty()) {
                     return make_unique<ast::MethodCall>(
-                            make_unique<ast::VariableValue>(std::move(names)), std::move(method_name),
+                            make_unique<ast::VariableValue>(std::move(names)), method_name,
                             std::move(args));
                 }
-                if (auto it = declared_classes_.find(method_name); it != declared_classes_.end()) {
-                    return make_unique<ast::NewInstance>(
-                            static_cast<const runtime::Class&>(*it->second), std::move(args));  // NOLINT
+                if (const runtime::Class* cls = FindClass(method_name)) {
+                    return make_unique<ast::NewInstance>(*cls, std::move(args));
                 }
-                if (method_name == "str"sv) {
+                if (method_name == STR_FUNCTION) {
                     if (args.size() != 1) {
                         throw ParseError("Function str takes exactly one argument"s);
                     }
                     return make_unique<ast::Stringify>(std::move(args.front()));
                 }
-                throw ParseError("Unknown call to "s + method_name + "()"s);
+                throw ParseError("Unknown call to "s + string(method_name.Name()) + "()"s);
             }
             return make_unique<ast::VariableValue>(std::move(names));
         }
@@ -323,77 +438,38 @@ namespace {
                                             std::move(else_body));
         }
 
-        // LogicalExpr -> AndTest [OR AndTest]
-        // AndTest -> NotTest [AND NotTest]
-        // NotTest -> [NOT] NotTest
-        //          | Comparison
+        // Test -> Binary(OR_PRECEDENCE)
+        // Binary(p) -> [NOT Binary(NOT_PRECEDENCE)] | Primary, then operators of precedence p or more
+        // Precedence climbing: one loop per call takes every operator the operand binds to,
+        // so a lone literal is parsed in three calls whatever the number of precedence levels
         unique_ptr<ast::Statement> ParseTest()  // NOLINT
         {
-            auto result = ParseAndTest();
-            while (lexer_.CurrentToken().Is<TokenType::Or>()) {
-                lexer_.NextToken();
-                result = make_unique<ast::Or>(std::move(result), ParseAndTest());
-            }
-            return result;
+            return ParseBinary(OR_PRECEDENCE);
         }
 
-        unique_ptr<ast::Statement> ParseAndTest()  // NOLINT
+        unique_ptr<ast::Statement> ParseBinary(int min_precedence)  // NOLINT
         {
-            auto result = ParseNotTest();
-            while (lexer_.CurrentToken().Is<TokenType::And>()) {
+            unique_ptr<ast::Statement> result;
+            int max_precedence = MULTIPLICATIVE_PRECEDENCE;
+            if (min_precedence <= NOT_PRECEDENCE && lexer_.CurrentToken().Is<TokenType::Not>()) {
                 lexer_.NextToken();
-                result = make_unique<ast::And>(std::move(result), ParseNotTest());
-            }
-            return result;
-        }
-
-        unique_ptr<ast::Statement> ParseNotTest()  // NOLINT
-        {
-            if (lexer_.CurrentToken().Is<TokenType::Not>()) {
-                lexer_.NextToken();
-                return make_unique<ast::Not>(ParseNotTest());  // NOLINT
-            }
-            return ParseComparison();
-        }
-
-        // Comparison -> Expr [COMP_OP Expr]
-        unique_ptr<ast::Statement> ParseComparison()  // NOLINT
-        {
-            auto result = ParseExpression();
-
-            const auto tok = lexer_.CurrentToken();
-
-            if (tok == '<') {
-                lexer_.NextToken();
-                return make_unique<ast::Comparison>(runtime::Less, std::move(result),
-                                                    ParseExpression());
-            }
-            if (tok == '>') {
-                lexer_.NextToken();
-                return make_unique<ast::Comparison>(runtime::Greater, std::move(result),
-                                                    ParseExpression());
-            }
-            if (tok.Is<TokenType::Eq>()) {
-                lexer_.NextToken();
-                return make_unique<ast::Comparison>(runtime::Equal, std::move(result),
-                                                    ParseExpression());
-            }
-            if (tok.Is<TokenType::NotEq>()) {
-                lexer_.NextToken();
-                return make_unique<ast::Comparison>(runtime::NotEqual, std::move(result),
-                                                    ParseExpression());
-            }
-            if (tok.Is<TokenType::LessOrEq>()) {
-                lexer_.NextToken();
-                return make_unique<ast::Comparison>(runtime::LessOrEqual, std::move(result),
-                                                    ParseExpression());
-            }
-            if (tok.Is<TokenType::GreaterOrEq>()) {
+                result = make_unique<ast::Not>(ParseBinary(NOT_PRECEDENCE));
+                max_precedence = NOT_PRECEDENCE - 1; // not took everything tighter, only and/or may follow
+            } else {
+                result = ParsePrimary();
+            }
+            for (;;) {
+                const BinaryOperator& op = FindBinaryOperator(lexer_.CurrentToken());
+                if (op.precedence < min_precedence || op.precedence > max_precedence) { // not an operator too
+                    return result;
+                }
                 lexer_.NextToken();
-                return make_unique<ast::Comparison>(runtime::GreaterOrEqual, std::move(result),
-                                                    ParseExpression());
+                // nothing binds tighter than '*' and '/' but a primary, which needs no loop of its own
+                auto rhs = op.precedence == MULTIPLICATIVE_PRECEDENCE ? ParsePrimary() : ParseBinary(op.precedence + 1);
+                result = op.build(std::move(result), std::move(rhs));
+                // operators of the same level chain to the left, comparisons don't chain at all
+                max_precedence = op.precedence == COMPARISON_PRECEDENCE ? COMPARISON_PRECEDENCE - 1 : op.precedence;
             }
-            return result;
         }
 
         // Statement -> SimpleStatement Newline
@@ -437,12 +513,28 @@ namespace {
             return ParseAssignmentOrCall();
         }
 
-        parse::Lexer& lexer_;
-        runtime::Closure declared_classes_;
+        parse::TokenStream& lexer_;
+        runtime::Closure& declared_classes_;
+        MethodParsing methods_;
+        shared_ptr<ClassHistory> history_; // kept only when method bodies are lazy
+        optional<size_t> visible_classes_; // set in a lazy method body, classes are looked up in history_ then
+        shared_ptr<parse::StringPool> body_strings_; // texts of String tokens in lazy bodies, made on the first one
     };
 
 }  // namespace
 
-unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer) {
-    return Parser{lexer}.ParseProgram();
+unique_ptr<runtime::Executable> ParseProgram(parse::TokenStream& tokens, MethodParsing methods) {
+    runtime::Closure declared_classes;
+    return ParseProgram(tokens, declared_classes, methods);
+}
+
+unique_ptr<runtime::Executable> ParseProgram(parse::TokenStream& tokens, runtime::Closure& declared_classes,
+                                             MethodParsing methods) {
+    auto arena = make_shared<runtime::Arena>();
+    unique_ptr<ast::Statement> body;
+    {
+        runtime::Arena::Scope scope(arena); // nodes of the program are bump-allocated, not one malloc each
+        body = Parser{tokens, declared_classes, methods}.ParseProgram();
+    }
+    return make_unique<ast::Program>(std::move(arena), std::move(body));
 }
\ No newline at end of file
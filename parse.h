@@ -1,18 +1,31 @@
 #pragma once
 
+#include "runtime.h"
+
 #include <memory>
 #include <stdexcept>
 
 namespace parse {
-class Lexer;
-}
-
-namespace runtime {
-class Executable;
+class TokenStream;
 }
 
 struct ParseError : std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
-std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
\ No newline at end of file
+// How method bodies are parsed: Eager builds them with the rest of the program, Lazy only finds the tokens of
+// each body and builds it the first time the method runs, see ast::LazyMethodBody. A lazy body refers to the same
+// classes as an eager one would, but its parse errors are thrown by the first call and optimization passes don't
+// see it until it is parsed
+enum class MethodParsing {
+    Eager,
+    Lazy,
+};
+
+std::unique_ptr<runtime::Executable> ParseProgram(parse::TokenStream& tokens,
+                                                  MethodParsing methods = MethodParsing::Eager);
+
+// Parses a part of program --classes declared by earlier parts are looked up in declared_classes,
+// classes this part declares are added to it
+std::unique_ptr<runtime::Executable> ParseProgram(parse::TokenStream& tokens, runtime::Closure& declared_classes,
+                                                  MethodParsing methods = MethodParsing::Eager);
\ No newline at end of file
@@ -1,4 +1,8 @@
+#include "flat_program.h"
+#include "incremental_parser.h"
 #include "lexer.h"
+#include "optimizer.h"
+#include "pass_manager.h"
 #include "parse.h"
 #include "statement.h"
 #include "test_runner_p.h"
@@ -7,10 +11,11 @@ using namespace std;
 
 namespace parse {
 
-unique_ptr<ast::Statement> ParseProgramFromString(const string& program) {
+unique_ptr<ast::Statement> ParseProgramFromString(const string& program,
+                                                  MethodParsing methods = MethodParsing::Eager) {
     istringstream is(program);
     parse::Lexer lexer(is);
-    return ParseProgram(lexer);
+    return ParseProgram(lexer, methods);
 }
 
 void TestSimpleProgram() {
@@ -266,6 +271,543 @@ x = X(xh)
     ASSERT_EQUAL(xh->Fields().at("x"s).Get(), closure.at("x"s).Get());
 }
 
+void TestIncrementalParser() {
+    const string program = R"(# counters
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add():
+    self.value = self.value + 1
+    return self.value
+
+c = Counter()
+c.add()
+print c.add()
+if c.value > 1:
+  print 'many'
+else:
+  print 'few'
+print 'x
+y'
+)"s;
+    IncrementalParser parser;
+    auto run = [&parser](const string& source) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        parser.Update(source).Execute(closure, context);
+        return context.output.str();
+    };
+
+    ASSERT_EQUAL(run(program), "2\nmany\nx\ny\n"s);
+    ASSERT_EQUAL(parser.LastStats().statements, 7U); // leading comment is a part of its own
+    ASSERT_EQUAL(parser.LastStats().lexed, 7U);
+    ASSERT_EQUAL(parser.LastStats().parsed, 7U);
+
+    ASSERT_EQUAL(run(program), "2\nmany\nx\ny\n"s); // cached trees run again with fresh objects
+    ASSERT_EQUAL(parser.LastStats().parsed, 0U);
+
+    string edited = "\n\n"s + program; // lines move, statements stay the same
+    edited.replace(edited.find("print c.add()"s), 13, "print c.value"s);
+    ASSERT_EQUAL(run(edited), "1\nfew\nx\ny\n"s);
+    ASSERT_EQUAL(parser.LastStats().lexed, 2U); // leading part and the edited line
+    ASSERT_EQUAL(parser.LastStats().parsed, 2U);
+
+    string class_edited = edited;
+    class_edited.replace(class_edited.find("self.value + 1"s), 14, "self.value + 5"s);
+    ASSERT_EQUAL(run(class_edited), "5\nmany\nx\ny\n"s);
+    ASSERT_EQUAL(parser.LastStats().lexed, 1U);
+    ASSERT_EQUAL(parser.LastStats().parsed, 6U); // statements after a changed class are parsed again
+
+    try {
+        run(class_edited + "print Unknown()\n"s);
+        ASSERT(false);
+    } catch (const ParseError&) {
+    }
+    ASSERT_EQUAL(run(class_edited), "5\nmany\nx\ny\n"s);
+    ASSERT_EQUAL(parser.LastStats().parsed, 7U); // failed update drops the cache
+}
+
+void TestArenaOutlivesProgram() {
+    runtime::Arena arena;
+    ASSERT_EQUAL(reinterpret_cast<uintptr_t>(arena.Allocate(8, 8)) % 8, 0u);
+    ASSERT_EQUAL(reinterpret_cast<uintptr_t>(arena.Allocate(1 << 20, 16)) % 16, 0u); // chunk of its own
+    ASSERT_EQUAL(arena.BytesUsed(), 8u + (1 << 20));
+
+    const string program = R"(
+class Counter:
+  def __init__():
+    self.n = 0
+  def add(k):
+    if k > 0:
+      self.n = self.n + k
+    return self.n
+c = Counter()
+)"s;
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ParseProgramFromString(program)->Execute(closure, context);
+    ASSERT(!runtime::Arena::Current());
+
+    // the tree is gone, methods of its class still run from the arena
+    auto& counter = *closure.at("c"s).TryAs<runtime::ClassInstance>();
+    counter.Call("add"s, {runtime::ObjectHolder::Own(runtime::Number{5})}, context);
+    auto result = counter.Call("add"s, {runtime::ObjectHolder::Own(runtime::Number{2})}, context);
+    ASSERT_EQUAL(result.TryAs<runtime::Number>()->GetValue(), 7);
+}
+
+void TestOperatorPrecedence() {
+    const string program = R"(
+a = 2
+b = 3
+c = 0
+print 1 + 2 * 3 - 4 / 2, 2 * (3 + 4), 10 - 4 - 3, 12 / 3 / 2, -a * b, -(a - b)
+print not a == b and c, not c or a < b and c, (a < b) == True, not not a, a + 1 > b or c
+)"s;
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ParseProgramFromString(program)->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "5 14 3 2 -6 1\nFalse True True True False\n"s);
+
+    // comparisons don't chain, neither at the top level nor after not
+    for (const string& chained : {"x = 1 < 2 < 3\n"s, "x = not 1 < 2 < 3\n"s, "x = a < b == True\n"s}) {
+        try {
+            ParseProgramFromString(chained);
+            ASSERT(false);
+        } catch (const runtime_error&) {
+        }
+    }
+}
+
+void TestFlatProgramSlots() {
+    const string program = R"(
+class Counter:
+  def __init__(start):
+    self.n = start
+
+  def add(k):
+    total = self.n + k
+    if k > 100:
+      unused = k
+    self.n = total
+    return self
+
+x = Counter(seed)
+y = x.add(2)
+y = y.add(3)
+print y.n, x.n
+)"s;
+    // the closure passed in is the name-keyed view of the top-level slots, both ways
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    closure[runtime::Symbol("seed"s)] = runtime::ObjectHolder::Own(runtime::Number{10});
+    ast::LowerToFlat(ParseProgramFromString(program))->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "15 15\n"s);
+    ASSERT(closure.count(runtime::Symbol("y"s)) == 1);
+    ASSERT(closure.count(runtime::Symbol("Counter"s)) == 1);
+
+    // a slot assigned in a branch not taken stays unbound
+    runtime::Closure empty;
+    auto unbound = ast::LowerToFlat(ParseProgramFromString("if 1 > 2:\n  z = 1\nprint z\n"s));
+    ASSERT_THROWS(unbound->Execute(empty, context), runtime_error);
+}
+
+void TestFoldConstants() {
+    const string program = R"(
+x = 2*5+10/2
+print x, 'a' + "b" + str(1 + 1), not 1 < 2, -x, True or y, False and y, -(3 - 5)
+)"s;
+    runtime::DummyContext tree_context;
+    runtime::Closure tree_closure;
+    ParseProgramFromString(program)->Execute(tree_closure, tree_context);
+
+    auto folded = ParseProgramFromString(program);
+    ASSERT(ast::FoldConstants(folded) > 0);
+    auto& body = dynamic_cast<ast::Compound&>(*dynamic_cast<ast::Program&>(*folded).GetBody()).GetStatements();
+    auto* x = dynamic_cast<ast::NumericConst*>(dynamic_cast<ast::Assignment&>(*body[0]).GetRv().get());
+    ASSERT(x != nullptr && x->GetValue().GetValue() == 15);
+    auto& args = dynamic_cast<ast::Print&>(*body[1]).GetArgs();
+    ASSERT(dynamic_cast<ast::StringConst*>(args[1].get()) != nullptr);
+    ASSERT(dynamic_cast<ast::Negate*>(args[3].get()) != nullptr);
+    for (size_t i : {2, 4, 5}) {
+        ASSERT(dynamic_cast<ast::BoolConst*>(args[i].get()) != nullptr);
+    }
+    ASSERT(dynamic_cast<ast::NumericConst*>(args[6].get()) != nullptr);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    folded->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), tree_context.output.str());
+    ASSERT_EQUAL(ast::FoldConstants(folded), 0u);
+
+    runtime::DummyContext flat_context;
+    runtime::Closure flat_closure;
+    ast::LowerToFlat(std::move(folded))->Execute(flat_closure, flat_context);
+    ASSERT_EQUAL(flat_context.output.str(), tree_context.output.str());
+
+    // division by zero is left to the program
+    auto division = ParseProgramFromString("print 'never'\nx = 1 / 0\n"s);
+    ast::FoldConstants(division);
+    runtime::Closure empty;
+    ASSERT_THROWS(division->Execute(empty, context), runtime_error);
+}
+
+void TestEliminateDeadCode() {
+    const string program = R"(
+class Toggles:
+  def run(x):
+    if False:
+      print 'debug'
+    if x > 0:
+      return 'positive'
+    else:
+      return 'other'
+    print 'unreachable'
+    return None
+
+t = Toggles()
+if True:
+  print t.run(1), t.run(0)
+else:
+  print 'off'
+if not True:
+  print 'off'
+print 'end'
+)"s;
+    runtime::DummyContext tree_context;
+    runtime::Closure tree_closure;
+    ParseProgramFromString(program)->Execute(tree_closure, tree_context);
+
+    auto tree = ParseProgramFromString(program);
+    ast::FoldConstants(tree);
+    ASSERT(ast::EliminateDeadCode(tree) > 0);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), tree_context.output.str());
+    ASSERT_EQUAL(ast::EliminateDeadCode(tree), 0u);
+
+    // the class, t, the print of the live branch and the last print are left at the top level
+    auto& body = dynamic_cast<ast::Compound&>(*dynamic_cast<ast::Program&>(*tree).GetBody()).GetStatements();
+    ASSERT_EQUAL(body.size(), 4u);
+    ASSERT(dynamic_cast<ast::Print*>(body[2].get()) != nullptr);
+
+    // only the if/else that returns is left in the method
+    const auto* cls = closure.at(runtime::Symbol("Toggles"s)).TryAs<runtime::Class>();
+    auto& method_body = dynamic_cast<ast::MethodBody&>(*cls->GetMethod(runtime::Symbol("run"s))->body);
+    auto& statements = dynamic_cast<ast::Compound&>(*method_body.GetBody()).GetStatements();
+    ASSERT_EQUAL(statements.size(), 1u);
+    ASSERT(dynamic_cast<ast::IfElse*>(statements[0].get()) != nullptr);
+}
+
+void TestPassManager() {
+    const string program = R"(
+class Sign:
+  def of(x):
+    if x < 0:
+      return -1
+    return 1
+    print 'unreachable'
+
+s = Sign()
+if 2 * 3 > 5:
+  print s.of(-7), s.of(2 + 2), 'on'
+else:
+  print 'off'
+)"s;
+    for (int level : {0, 1, 2}) {
+        auto passes = ast::PassManager::ForLevel(level);
+        auto tree = ParseProgramFromString(program);
+        passes.Run(tree);
+        ASSERT_EQUAL(passes.GetStatistics().size(), level == 0 ? 0u : level == 1 ? 2u : 4u);
+        ASSERT_EQUAL((dynamic_cast<ast::FlatProgram*>(tree.get()) != nullptr), level == 2);
+
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        tree->Execute(closure, context);
+        ASSERT_EQUAL(context.output.str(), "-1 1 on\n"s);
+    }
+
+    auto passes = ast::PassManager::FromList("eliminate-dead-code,fold-constants"sv);
+    auto tree = ParseProgramFromString(program);
+    passes.Run(tree);
+    ASSERT_EQUAL(passes.GetStatistics()[0].name, "eliminate-dead-code"s);
+    ASSERT(passes.GetStatistics()[1].changes > 0);
+    ASSERT_THROWS(ast::PassManager::FromList("fold-constants,inline-everything"sv), invalid_argument);
+    ASSERT_THROWS(ast::PassManager::ForLevel(3), invalid_argument);
+}
+
+void TestInlineMethods() {
+    const string program = R"(
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def get_x():
+    return self.x
+
+  def set_x(value):
+    self.x = value
+
+  def dot(other):
+    return self.x * other.x + self.y * other.y
+
+  def norm():
+    return self.dot(self)
+
+class Named(Point):
+  def name():
+    return 'named'
+
+p = Point(1, 2)
+q = Named(3, 4)
+p.set_x(10)
+q.set_x(30)
+print p.get_x(), q.get_x(), p.dot(q), q.dot(p), p.set_x(7), p.x, p.norm(), q.name()
+)"s;
+    runtime::DummyContext tree_context;
+    runtime::Closure tree_closure;
+    ParseProgramFromString(program)->Execute(tree_closure, tree_context);
+    ASSERT_EQUAL(tree_context.output.str(), "10 30 308 308 None 7 53 named\n"s);
+
+    // every call but norm(), which makes a call itself, is inlined --dot() inside norm() as well. Calls of Point's
+    // methods on q take the guard's fallback, since Named is another class
+    auto tree = ParseProgramFromString(program);
+    ASSERT_EQUAL(ast::InlineMethods(tree), 9u);
+    ASSERT_EQUAL(ast::InlineMethods(tree), 0u);
+    size_t inlined = 0;
+    std::function<void(unique_ptr<ast::Statement>&)> count = [&](unique_ptr<ast::Statement>& node) {
+        inlined += dynamic_cast<ast::InlinedCall*>(node.get()) != nullptr ? 1 : 0;
+        ast::ForEachChild(*node, count);
+    };
+    count(tree);
+    ASSERT_EQUAL(inlined, 9u);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), tree_context.output.str());
+
+    auto flat_tree = ParseProgramFromString(program);
+    ast::InlineMethods(flat_tree);
+    runtime::DummyContext flat_context;
+    runtime::Closure flat_closure;
+    ast::LowerToFlat(std::move(flat_tree))->Execute(flat_closure, flat_context);
+    ASSERT_EQUAL(flat_context.output.str(), tree_context.output.str());
+
+    // a receiver that isn't an object fails as the call would
+    auto number = ParseProgramFromString(program + "n = 5\nprint n.get_x()\n"s);
+    ast::InlineMethods(number);
+    runtime::Closure number_closure;
+    ASSERT_THROWS(number->Execute(number_closure, context), runtime_error);
+
+    // self.x.y reads self.y when self.x isn't an object, such chains stay calls
+    const string chain = R"(
+class Box:
+  def __init__():
+    self.x = 5
+    self.y = 7
+
+  def chained():
+    return self.x.y
+
+b = Box()
+print b.chained()
+)"s;
+    auto chain_tree = ParseProgramFromString(chain);
+    ASSERT_EQUAL(ast::InlineMethods(chain_tree), 0u);
+    runtime::DummyContext chain_context;
+    runtime::Closure chain_closure;
+    chain_tree->Execute(chain_closure, chain_context);
+    ASSERT_EQUAL(chain_context.output.str(), "7\n"s);
+
+    // + of an inlined body calls __add__, which runs the same inlined body again before the outer one reads b
+    const string reentrant = R"(
+class Helper:
+  def plus(a, b):
+    return a + b - b
+
+class Counter:
+  def __init__(n, next, helper):
+    self.n = n
+    self.next = next
+    self.helper = helper
+
+  def __add__(x):
+    if self.n == 1:
+      return x * 2
+    return self.helper.plus(self.next, x + self.n) + self.n
+
+h = Helper()
+c0 = Counter(1, None, h)
+c1 = Counter(2, c0, h)
+c2 = Counter(3, c1, h)
+print h.plus(c2, 100)
+)"s;
+    runtime::DummyContext reentrant_context;
+    runtime::Closure reentrant_closure;
+    ParseProgramFromString(reentrant)->Execute(reentrant_closure, reentrant_context);
+    ASSERT_EQUAL(reentrant_context.output.str(), "-93\n"s);
+    for (bool flat : {false, true}) {
+        auto inlined_tree = ParseProgramFromString(reentrant);
+        ASSERT_EQUAL(ast::InlineMethods(inlined_tree), 2u);
+        if (flat) {
+            inlined_tree = ast::LowerToFlat(std::move(inlined_tree));
+        }
+        runtime::DummyContext inlined_context;
+        runtime::Closure inlined_closure;
+        inlined_tree->Execute(inlined_closure, inlined_context);
+        ASSERT_EQUAL(inlined_context.output.str(), reentrant_context.output.str());
+    }
+}
+
+void TestLazyMethodBodies() {
+    const string program = R"(
+class Point:
+  def __init__():
+    self.x = 0
+
+class Shape:
+  def __init__(name):
+    self.name = name
+
+  def area():
+    return 0
+
+  def describe():
+    if self.area() > 5:
+      return self.name + ' ' + str(self.area())
+    return 'small'
+
+  def origin():
+    return Point()
+
+  def broken():
+    return missing(1)
+
+  def make_square():
+    return Square(2)
+
+class Square(Shape):
+  def __init__(side):
+    self.side = side
+    self.name = 'square'
+
+  def area():
+    return self.side * self.side
+
+s = Square(3)
+d = Shape('dot')
+o = s.origin()
+print s.describe(), d.describe(), o.x
+)"s;
+    // broken(), which calls no class or function, and make_square(), which calls a class declared after it, fail
+    // only when they are called
+    ASSERT_THROWS(ParseProgramFromString(program), ParseError);
+    auto tree = ParseProgramFromString(program, MethodParsing::Lazy);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "square 9 small 0\n"s);
+
+    auto body = [&closure](const string& cls, const string& method) {
+        const auto* c = closure.at(runtime::Symbol(cls)).TryAs<runtime::Class>();
+        return dynamic_cast<ast::LazyMethodBody*>(c->GetMethod(runtime::Symbol(method))->body.get());
+    };
+    ASSERT(body("Square"s, "area"s)->IsParsed());
+    ASSERT(body("Shape"s, "describe"s)->IsParsed());
+    ASSERT(!body("Shape"s, "broken"s)->IsParsed());
+    ASSERT(!body("Shape"s, "make_square"s)->IsParsed());
+
+    auto& square = closure.at(runtime::Symbol("s"s));
+    ASSERT_THROWS(square.TryAs<runtime::ClassInstance>()->Call(runtime::Symbol("broken"s), {}, context), ParseError);
+    ASSERT_THROWS(square.TryAs<runtime::ClassInstance>()->Call(runtime::Symbol("make_square"s), {}, context),
+                  ParseError);
+
+    // passes leave bodies that aren't parsed yet alone, they run as parsed
+    const string valid = program.substr(0, program.find("  def broken")) + program.substr(program.find("class Square"));
+    for (int level : {1, 2}) {
+        auto optimized = ParseProgramFromString(valid, MethodParsing::Lazy);
+        ast::PassManager::ForLevel(level).Run(optimized);
+        runtime::DummyContext optimized_context;
+        runtime::Closure optimized_closure;
+        optimized->Execute(optimized_closure, optimized_context);
+        ASSERT_EQUAL(optimized_context.output.str(), context.output.str());
+    }
+}
+
+void TestFlatProgram() {
+    const vector<string> programs = {
+            R"(
+class GCD:
+  def __init__():
+    self.call_count = 0
+
+  def calc(a, b):
+    self.call_count = self.call_count + 1
+    if a < b:
+      return self.calc(b, a)
+    if b == 0:
+      return a
+    return self.calc(a - b, b)
+
+x = GCD()
+print x.calc(510510, 18629977), x.calc(22, 17), x.call_count
+)"s,
+            R"(
+class Shape:
+  def __str__():
+    return "Shape"
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.w = w
+    self.h = h
+
+  def __add__(other):
+    return self.w + other.w
+
+  def __str__():
+    return "Rect(" + str(self.w) + 'x' + str(self.h) + ')'
+
+r = Rect(10, 20)
+print r, r + Rect(1, 2), str(None), r.w * 2 - 6 / 3
+print 1 < 2, 2 <= 1, 3 > 2, 2 >= 3, 1 == 1, 1 != 1, not None, 0 or 'a', 1 and ''
+s = 'a'
+if s == 'a':
+  s = s + 'b'
+else:
+  s = 'c'
+print s
+)"s,
+    };
+    for (const string& program : programs) {
+        runtime::DummyContext tree_context;
+        runtime::Closure tree_closure;
+        ParseProgramFromString(program)->Execute(tree_closure, tree_context);
+
+        runtime::DummyContext flat_context;
+        runtime::Closure flat_closure;
+        auto flat = ast::LowerToFlat(ParseProgramFromString(program));
+        ASSERT(dynamic_cast<ast::FlatProgram*>(flat.get()) != nullptr);
+        flat->Execute(flat_closure, flat_context);
+
+        ASSERT_EQUAL(flat_context.output.str(), tree_context.output.str());
+    }
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    auto division = ast::LowerToFlat(ParseProgramFromString("print 1 / 0\n"s));
+    try {
+        division->Execute(closure, context);
+        ASSERT(false);
+    } catch (const runtime_error&) {
+    }
+}
+
 }  // namespace parse
 
 void TestParseProgram(TestRunner& tr) {
@@ -278,4 +820,14 @@ void TestParseProgram(TestRunner& tr) {
     RUN_TEST(tr, parse::TestComplexLogicalExpression);
     RUN_TEST(tr, parse::TestClassicalPolymorphism);
     RUN_TEST(tr, parse::TestSelfInConstructor);
+    RUN_TEST(tr, parse::TestIncrementalParser);
+    RUN_TEST(tr, parse::TestArenaOutlivesProgram);
+    RUN_TEST(tr, parse::TestOperatorPrecedence);
+    RUN_TEST(tr, parse::TestFlatProgram);
+    RUN_TEST(tr, parse::TestFlatProgramSlots);
+    RUN_TEST(tr, parse::TestFoldConstants);
+    RUN_TEST(tr, parse::TestEliminateDeadCode);
+    RUN_TEST(tr, parse::TestPassManager);
+    RUN_TEST(tr, parse::TestInlineMethods);
+    RUN_TEST(tr, parse::TestLazyMethodBodies);
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "pass_manager.h"
+
+#include "flat_program.h"
+#include "optimizer.h"
+
+#include <chrono>
+#include <ostream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace ast {
+
+    namespace {
+
+        size_t LowerToFlatPass(unique_ptr<Statement>& tree) {
+            tree = LowerToFlat(std::move(tree));
+            return 1;
+        }
+
+        const vector<Pass>& KnownPasses() {
+            static const vector<Pass> passes{
+                    {"fold-constants"s, FoldConstants},
+                    {"eliminate-dead-code"s, EliminateDeadCode},
+                    {"inline-methods"s, InlineMethods},
+                    {"lower-to-flat"s, LowerToFlatPass},
+            };
+            return passes;
+        }
+
+#ifndef NDEBUG
+        // Every child slot a node has must hold a node --a pass that moves a subtree out and forgets to put
+        // something back leaves nullptr behind
+        void VerifyTree(Statement& node, const string& pass) {  // NOLINT(misc-no-recursion)
+            ForEachChild(node, [&pass](unique_ptr<Statement>& child) {
+                if (!child) {
+                    throw logic_error("PassManager::Run(): pass "s + pass + " left an empty child slot"s);
+                }
+                VerifyTree(*child, pass);
+            });
+        }
+#endif
+
+    }  // namespace
+
+    Pass FindPass(string_view name) {
+        for (const Pass& pass : KnownPasses()) {
+            if (pass.name == name) {
+                return pass;
+            }
+        }
+        throw invalid_argument("FindPass(): unknown pass "s + string(name));
+    }
+
+    PassManager PassManager::ForLevel(int level) {
+        switch (level) {
+            case 0:
+                return {};
+            case 1:
+                return FromList("fold-constants,eliminate-dead-code"sv);
+            case 2:
+                return FromList("fold-constants,eliminate-dead-code,inline-methods,lower-to-flat"sv);
+            default:
+                throw invalid_argument("PassManager::ForLevel(): no level "s + to_string(level));
+        }
+    }
+
+    PassManager PassManager::FromList(string_view names) {
+        PassManager manager;
+        while (!names.empty()) {
+            size_t comma = names.find(',');
+            manager.Add(FindPass(names.substr(0, comma)));
+            names.remove_prefix(comma == string_view::npos ? names.size() : comma + 1);
+        }
+        return manager;
+    }
+
+    PassManager& PassManager::Add(Pass pass) {
+        passes_.push_back(std::move(pass));
+        return *this;
+    }
+
+    void PassManager::Run(unique_ptr<Statement>& tree) {
+        statistics_.clear();
+        for (const Pass& pass : passes_) {
+            auto start = chrono::steady_clock::now();
+            size_t changes = pass.run(tree);
+            chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+            statistics_.push_back({pass.name, elapsed.count(), changes});
+#ifndef NDEBUG
+            if (!tree) {
+                throw logic_error("PassManager::Run(): pass "s + pass.name + " dropped the program"s);
+            }
+            VerifyTree(*tree, pass.name);
+#endif
+        }
+    }
+
+    const vector<PassManager::Statistics>& PassManager::GetStatistics() const {
+        return statistics_;
+    }
+
+    void PassManager::PrintStatistics(ostream& out) const {
+        for (const Statistics& pass : statistics_) {
+            out << pass.name << ": "sv << pass.changes << " changes, "sv << pass.seconds * 1e3 << " ms\n"sv;
+        }
+    }
+
+}  // namespace ast
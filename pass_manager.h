@@ -0,0 +1,58 @@
+#pragma once
+
+#include "statement.h"
+
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ast {
+
+    // Program transformation or analysis run between ParseProgram and Execute --returns the number of changes it
+    // made, an analysis returns 0 and leaves the tree as it is
+    struct Pass {
+        std::string name;
+        std::function<size_t(std::unique_ptr<Statement>&)> run;
+    };
+
+    // Known passes by name: fold-constants, eliminate-dead-code, inline-methods, lower-to-flat. Throws
+    // invalid_argument for others
+    Pass FindPass(std::string_view name);
+
+    // Runs an ordered list of passes over a program, timing each one
+    // Debug builds check the tree after every pass, so a pass that breaks it is named right away
+    class PassManager {
+    public:
+        struct Statistics {
+            std::string name;
+            double seconds = 0;
+            size_t changes = 0;
+        };
+
+        // Presets of the -O options: 0 runs nothing, 1 folds constants and eliminates dead code,
+        // 2 also inlines small methods and lowers the program into a FlatProgram. Throws invalid_argument for
+        // other levels
+        static PassManager ForLevel(int level);
+
+        // Passes named in a comma-separated list, in its order
+        static PassManager FromList(std::string_view names);
+
+        PassManager& Add(Pass pass);
+
+        // Runs the passes in order, statistics of the previous run are dropped
+        void Run(std::unique_ptr<Statement>& tree);
+
+        [[nodiscard]] const std::vector<Statistics>& GetStatistics() const;
+
+        // One line per pass of the last run
+        void PrintStatistics(std::ostream& out) const;
+
+    private:
+        std::vector<Pass> passes_;
+        std::vector<Statistics> statistics_;
+    };
+
+}  // namespace ast
@@ -0,0 +1,135 @@
+#include "pipelined_lexer.h"
+
+#include "parallel_lexer.h"
+
+#include <algorithm>
+#include <istream>
+#include <optional>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+namespace parse {
+
+    PipelinedLexer::PipelinedLexer(std::istream& input)
+            : PipelinedLexer([this, &input] { ScanStream(input); }) {
+    }
+
+    PipelinedLexer::PipelinedLexer(std::string_view source)
+            : PipelinedLexer([this, source] {
+                  Lexer lexer(source);
+                  PushTokens(lexer, 1, true);
+              }) {
+    }
+
+    PipelinedLexer::PipelinedLexer(MappedFile file)
+            : PipelinedLexer([this, file = make_shared<MappedFile>(std::move(file))] { // std::function needs a copyable callable
+                  Lexer lexer(std::move(*file));
+                  PushTokens(lexer, 1, true);
+              }) {
+    }
+
+    PipelinedLexer::PipelinedLexer(Scan scan) {
+        producer_ = thread([this, scan = std::move(scan)] { Produce(scan); });
+        try {
+            PopInto(window_[0]); // first token is ready after construction, same as with Lexer
+        } catch (...) {
+            producer_.join(); // producer has already pushed its final Eof
+            throw;
+        }
+    }
+
+    PipelinedLexer::~PipelinedLexer() {
+        stop_.store(true, memory_order_release);
+        queue_.WakeAll();
+        producer_.join();
+    }
+
+    const Token& PipelinedLexer::CurrentToken() const {
+        return window_[current_ % kTokenWindow];
+    }
+
+    const Token& PipelinedLexer::NextToken() {
+        if (CurrentToken().Is<token_type::Eof>()) { // nothing follows Eof --producer has finished
+            return CurrentToken();
+        }
+        Token& slot = window_[(current_ + 1) % kTokenWindow];
+        ++current_;
+        PopInto(slot);
+        return slot;
+    }
+
+    void PipelinedLexer::PopInto(Token& slot) {
+        queue_.Pop(slot);
+        if (slot.Is<token_type::Eof>() && error_) { // error_ is published by the push of Eof
+            rethrow_exception(error_);
+        }
+    }
+
+    void PipelinedLexer::Produce(const Scan& scan) {
+        try {
+            scan();
+        } catch (...) {
+            error_ = current_exception();
+            Push(Token(token_type::Eof{}));
+        }
+    }
+
+    void PipelinedLexer::ScanStream(std::istream& input) {
+        string pending; // text read but not scanned yet, starts at a top-level statement
+        StatementCutter cutter;
+        uint32_t line = 1; // line of the source pending starts at
+        for (bool at_end = false; !at_end;) {
+            size_t size = pending.size();
+            pending.resize(size + kReadSize);
+            input.read(pending.data() + size, static_cast<streamsize>(kReadSize));
+            pending.resize(size + static_cast<size_t>(input.gcount()));
+            at_end = !input;
+
+            // Statements before the last cut are complete --the last one may go on in the next block
+            size_t cut = pending.size();
+            if (!at_end) {
+                cut = 0;
+                while (optional<size_t> next = cutter.NextCut(pending, false)) {
+                    cut = *next;
+                }
+            }
+            if (cut == 0) {
+                continue;
+            }
+            string_view part(pending.data(), cut);
+            Lexer lexer(part);
+            if (!PushTokens(lexer, line, at_end)) {
+                return;
+            }
+            line += static_cast<uint32_t>(std::count(part.begin(), part.end(), '\n'));
+            pending.erase(0, cut);
+            cutter.Drop(cut);
+        }
+    }
+
+    bool PipelinedLexer::PushTokens(Lexer& lexer, uint32_t first_line, bool keep_eof) {
+        strings_.push_back(lexer.Strings());
+        while (true) {
+            Token token = lexer.CurrentToken();
+            bool is_eof = token.Is<token_type::Eof>();
+            if (is_eof && !keep_eof) { // a part's lexer closes its blocks like the serial one at a column-0 line
+                return true;
+            }
+            token.SetPosition(token.Line() + first_line - 1, token.Column());
+            if (!Push(std::move(token))) {
+                return false;
+            }
+            if (is_eof) {
+                return true;
+            }
+            lexer.NextToken();
+        }
+    }
+
+    bool PipelinedLexer::Push(Token&& token) {
+        return queue_.Push(std::move(token), stop_); // value is moved only when a slot is free
+    }
+
+}  // namespace parse
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "lexer.h"
+#include "spsc_queue.h"
+
+#include <array>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace parse {
+
+    // Token stream scanned by a Lexer on its own thread
+    // Reading the source and scanning run ahead of the parser through a bounded ring of tokens
+    // Lexer errors are thrown by NextToken when the parser reaches the failed position, same as with Lexer
+    class PipelinedLexer : public TokenStream {
+    public:
+        // Reads the stream on the producer thread kReadSize bytes at a time --stream must outlive the lexer
+        // Top-level statements read so far are scanned while the next block is read, the way ParallelLexer
+        // scans its chunks, so tokens reach the parser before the stream ends
+        explicit PipelinedLexer(std::istream& input);
+
+        // Scans caller-owned contiguous source --source must outlive the lexer
+        explicit PipelinedLexer(std::string_view source);
+
+        // Scans memory-mapped file, the mapping is owned by the producer thread
+        explicit PipelinedLexer(MappedFile file);
+
+        PipelinedLexer(const PipelinedLexer&) = delete;
+        PipelinedLexer& operator=(const PipelinedLexer&) = delete;
+
+        // Stops the producer even if it waits on the full ring
+        ~PipelinedLexer() override;
+
+        [[nodiscard]] const Token& CurrentToken() const override;
+
+        const Token& NextToken() override;
+
+        // Number of tokens the producer may scan ahead of the parser
+        static constexpr size_t kQueueCapacity = 1024;
+
+        // Bytes read from a stream at a time
+        static constexpr size_t kReadSize = 64 * 1024;
+
+    private:
+        using Scan = std::function<void()>; // pushes all tokens up to the final Eof, stops if Push fails
+
+        explicit PipelinedLexer(Scan scan);
+
+        void Produce(const Scan& scan); // producer thread body
+        void ScanStream(std::istream& input);
+        // Pushes lexer's tokens with lines counted from first_line, its Eof only if keep_eof --false if consumer has gone
+        bool PushTokens(Lexer& lexer, uint32_t first_line, bool keep_eof);
+        bool Push(Token&& token); // waits for a free slot, returns false if consumer has gone
+        void PopInto(Token& slot); // waits for the next token, rethrows producer's error at its Eof
+
+        SpscQueue<Token, kQueueCapacity> queue_;
+        std::exception_ptr error_; // set by producer before it pushes the final Eof
+        std::atomic<bool> stop_{false};
+        std::vector<std::shared_ptr<StringPool>> strings_; // producer's only --queued tokens outlive its lexers
+        std::array<Token, kTokenWindow> window_; // consumer's recent tokens --keeps references valid like Lexer
+        size_t current_ = 0;
+        std::thread producer_;
+    };
+
+}  // namespace parse
@@ -1,8 +1,13 @@
 #include "runtime.h"
 
+#include "arena.h"
+
 #include <cassert>
+#include <cstddef>
+#include <new>
 #include <optional>
 #include <sstream>
+#include <typeinfo>
 #include <utility>
 #include <algorithm>
 
@@ -10,6 +15,45 @@ using namespace std;
 
 namespace runtime {
 
+    namespace {
+        const Symbol SELF_NAME{"self"};
+        const Symbol STR_METHOD{"__str__"};
+        const Symbol EQ_METHOD{"__eq__"};
+        const Symbol LT_METHOD{"__lt__"};
+
+        // Precedes every Executable --tells operator delete whether the node is freed with its arena
+        struct alignas(std::max_align_t) NodeHeader {
+            bool in_arena = false;
+        };
+    }  // namespace
+
+    void* Executable::operator new(size_t size) {
+        const auto& arena = Arena::Current();
+        void* block = arena ? arena->Allocate(sizeof(NodeHeader) + size, alignof(NodeHeader))
+                            : ::operator new(sizeof(NodeHeader) + size);
+        return new (block) NodeHeader{arena != nullptr} + 1;
+    }
+
+    void Executable::operator delete(void* p) {
+        if (p == nullptr) {
+            return;
+        }
+        auto* header = static_cast<NodeHeader*>(p) - 1;
+        if (!header->in_arena) {
+            ::operator delete(header);
+        }
+    }
+
+    ObjectHolder Executable::ExecuteMethod(const Method& method, const ObjectHolder& self,
+                                           const std::vector<ObjectHolder>& actual_args, Context& context) {
+        Closure args;
+        args[SELF_NAME] = self;
+        for (size_t i = 0; i < actual_args.size(); ++i) {
+            args[method.formal_params[i]] = actual_args[i];
+        }
+        return Execute(args, context);
+    }
+
     ObjectHolder::ObjectHolder(std::shared_ptr<Object> data): data_(std::move(data)) { }
 
     void ObjectHolder::AssertIsValid() const {
@@ -56,20 +100,16 @@ namespace runtime {
     }
 
     void ClassInstance::Print(std::ostream& os, Context& context) {
-        if (HasMethod("__str__", 0)) {
-            Call("__str__", {}, context).Get()->Print(os, context);
+        if (HasMethod(STR_METHOD, 0)) {
+            Call(STR_METHOD, {}, context).Get()->Print(os, context);
         } else {
             os << this;
         }
     }
 
-    bool ClassInstance::HasMethod(const std::string& method, size_t argument_count) const {
-        if (cls_.GetMethod(method) != nullptr) {
-            if (cls_.GetMethod(method)->formal_params.size() == argument_count) {
-                return true;
-            }
-        }
-        return false;
+    bool ClassInstance::HasMethod(Symbol method, size_t argument_count) const {
+        const Method* method_ptr = cls_.GetMethod(method);
+        return method_ptr != nullptr && method_ptr->formal_params.size() == argument_count;
     }
 
     Closure& ClassInstance::Fields() {
@@ -82,15 +122,10 @@ namespace runtime {
 
     ClassInstance::ClassInstance(const Class&  cls): cls_(cls){}
 
-    ObjectHolder ClassInstance::Call(const std::string& method, const std::vector<ObjectHolder>& actual_args, Context& context) {
+    ObjectHolder ClassInstance::Call(Symbol method, const std::vector<ObjectHolder>& actual_args, Context& context) {
         if (HasMethod(method, actual_args.size())) {
-            Closure args;
-            args["self"s] = ObjectHolder::Share(*this);
             const Method* method_ptr = cls_.GetMethod(method);
-            for (size_t i = 0; i < actual_args.size(); ++i) {
-                args[method_ptr->formal_params[i]] = actual_args[i];
-            }
-            return method_ptr->body->Execute(args, context);
+            return method_ptr->body->ExecuteMethod(*method_ptr, ObjectHolder::Share(*this), actual_args, context);
         }
         throw std::runtime_error("Not implemented"s);
     }
@@ -103,9 +138,9 @@ namespace runtime {
         std::for_each(methods_.begin(), methods_.end(), [this](const Method& method) {methods_parts_[method.name] = &method; });
     }
 
-    const Method* Class::GetMethod(const std::string& name) const {
-        if (methods_parts_.count(name) > 0) {
-            return methods_parts_.at(name);
+    const Method* Class::GetMethod(Symbol name) const {
+        if (auto it = methods_parts_.find(name); it != methods_parts_.end()) {
+            return it->second;
         }
         return nullptr;
     }
@@ -114,6 +149,10 @@ namespace runtime {
         return this->name_;
     }
 
+    std::vector<Method>& Class::GetOwnMethods() {
+        return methods_;
+    }
+
     void Class::Print(ostream& os, Context& /*context*/) {
         os << "Class " << name_;
     }
@@ -122,49 +161,119 @@ namespace runtime {
         os << (GetValue() ? "True"sv : "False"sv);
     }
 
-    bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-        if (lhs.TryAs<Number>() && rhs.TryAs<Number>()){
-            return lhs.TryAs<Number>()->GetValue() == rhs.TryAs<Number>()->GetValue();
-        } else if (lhs.TryAs<String>() && rhs.TryAs<String>()) {
-            return lhs.TryAs<String>()->GetValue() == rhs.TryAs<String>()->GetValue();
-        } else if (lhs.TryAs<Bool>() && rhs.TryAs<Bool>()){
-            return lhs.TryAs<Bool>()->GetValue() == rhs.TryAs<Bool>()->GetValue();
-        } else if (!lhs && !rhs) {
-            return true;
-        } else if (lhs.TryAs<ClassInstance>() && lhs.TryAs<ClassInstance>()->HasMethod("__eq__"s, 1)) {
-            return lhs.TryAs<ClassInstance>()->Call("__eq__"s, {rhs}, context).TryAs<Bool>()->GetValue();
+    namespace {
+        template <CompareOp op, typename T>
+        bool Apply(const T& lhs, const T& rhs) {
+            if constexpr (op == CompareOp::Equal) {
+                return lhs == rhs;
+            } else if constexpr (op == CompareOp::NotEqual) {
+                return lhs != rhs;
+            } else if constexpr (op == CompareOp::Less) {
+                return lhs < rhs;
+            } else if constexpr (op == CompareOp::Greater) {
+                return lhs > rhs;
+            } else if constexpr (op == CompareOp::LessOrEqual) {
+                return lhs <= rhs;
+            } else {
+                return lhs >= rhs;
+            }
         }
-        throw std::runtime_error("Cannot compare objects for equality"s);
 
+        // lhs <op> rhs for two numbers, strings or Bool values, nullopt for any other operands
+        // One typeid per operand instead of a dynamic_cast per type tried
+        template <CompareOp op>
+        optional<bool> ComparePrimitives(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+            const Object* l = lhs.Get();
+            const Object* r = rhs.Get();
+            if (l == nullptr || r == nullptr) {
+                return nullopt;
+            }
+            const type_info& type = typeid(*l);
+            if (type != typeid(*r)) {
+                return nullopt;
+            }
+            if (type == typeid(Number)) {
+                return Apply<op>(static_cast<const Number*>(l)->GetValue(), static_cast<const Number*>(r)->GetValue());
+            }
+            if (type == typeid(String)) {
+                return Apply<op>(static_cast<const String*>(l)->GetValue(), static_cast<const String*>(r)->GetValue());
+            }
+            if (type == typeid(Bool)) {
+                return Apply<op>(static_cast<const Bool*>(l)->GetValue(), static_cast<const Bool*>(r)->GetValue());
+            }
+            return nullopt;
+        }
+
+        // Equality of operands that aren't a pair of primitives
+        bool EqualObjects(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+            if (!lhs && !rhs) {
+                return true;
+            }
+            if (auto* instance = lhs.TryAs<ClassInstance>(); instance != nullptr && instance->HasMethod(EQ_METHOD, 1)) {
+                return instance->Call(EQ_METHOD, {rhs}, context).TryAs<Bool>()->GetValue();
+            }
+            throw std::runtime_error("Cannot compare objects for equality"s);
+        }
+
+        // Order of operands that aren't a pair of primitives
+        bool LessObjects(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+            if (auto* instance = lhs.TryAs<ClassInstance>(); instance != nullptr && instance->HasMethod(LT_METHOD, 1)) {
+                return instance->Call(LT_METHOD, {rhs}, context).TryAs<Bool>()->GetValue();
+            }
+            throw std::runtime_error("Cannot compare objects for equality"s);
+        }
+    }  // namespace
+
+    template <CompareOp op>
+    bool Compare(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+        if (optional<bool> result = ComparePrimitives<op>(lhs, rhs)) {
+            return *result;
+        }
+        // objects only have __eq__ and __lt__, the other operators are made of them
+        if constexpr (op == CompareOp::Equal) {
+            return EqualObjects(lhs, rhs, context);
+        } else if constexpr (op == CompareOp::NotEqual) {
+            return !EqualObjects(lhs, rhs, context);
+        } else if constexpr (op == CompareOp::Less) {
+            return LessObjects(lhs, rhs, context);
+        } else if constexpr (op == CompareOp::Greater) {
+            return !LessObjects(lhs, rhs, context) && !EqualObjects(lhs, rhs, context);
+        } else if constexpr (op == CompareOp::LessOrEqual) {
+            return LessObjects(lhs, rhs, context) || EqualObjects(lhs, rhs, context);
+        } else {
+            return !LessObjects(lhs, rhs, context);
+        }
+    }
+
+    template bool Compare<CompareOp::Equal>(const ObjectHolder&, const ObjectHolder&, Context&);
+    template bool Compare<CompareOp::NotEqual>(const ObjectHolder&, const ObjectHolder&, Context&);
+    template bool Compare<CompareOp::Less>(const ObjectHolder&, const ObjectHolder&, Context&);
+    template bool Compare<CompareOp::Greater>(const ObjectHolder&, const ObjectHolder&, Context&);
+    template bool Compare<CompareOp::LessOrEqual>(const ObjectHolder&, const ObjectHolder&, Context&);
+    template bool Compare<CompareOp::GreaterOrEqual>(const ObjectHolder&, const ObjectHolder&, Context&);
+
+    bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+        return Compare<CompareOp::Equal>(lhs, rhs, context);
     }
 
     bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-        if (lhs.TryAs<Number>() && rhs.TryAs<Number>()){
-            return lhs.TryAs<Number>()->GetValue() < rhs.TryAs<Number>()->GetValue();
-        } else if (lhs.TryAs<String>() && rhs.TryAs<String>()) {
-            return lhs.TryAs<String>()->GetValue() < rhs.TryAs<String>()->GetValue();
-        } else if (lhs.TryAs<Bool>() && rhs.TryAs<Bool>()){
-            return lhs.TryAs<Bool>()->GetValue() < rhs.TryAs<Bool>()->GetValue();
-        } else if (lhs.TryAs<ClassInstance>() && lhs.TryAs<ClassInstance>()->HasMethod("__lt__"s, 1)) {
-            return lhs.TryAs<ClassInstance>()->Call("__lt__"s, {rhs}, context).TryAs<Bool>()->GetValue();
-        }
-        throw std::runtime_error("Cannot compare objects for equality"s);
+        return Compare<CompareOp::Less>(lhs, rhs, context);
     }
 
     bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-        return !Equal(lhs, rhs, context);
+        return Compare<CompareOp::NotEqual>(lhs, rhs, context);
     }
 
     bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-        return !Less(lhs, rhs, context) && !Equal(lhs, rhs, context);
+        return Compare<CompareOp::Greater>(lhs, rhs, context);
     }
 
     bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-        return !Greater(lhs, rhs, context);
+        return Compare<CompareOp::LessOrEqual>(lhs, rhs, context);
     }
 
     bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-        return !Less(lhs, rhs, context);
+        return Compare<CompareOp::GreaterOrEqual>(lhs, rhs, context);
     }
 
 }  // namespace runtime
\ No newline at end of file
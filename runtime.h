@@ -1,5 +1,8 @@
 #pragma once
 
+#include "symbol.h"
+
+#include <cstdint>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -85,20 +88,32 @@ namespace runtime {
     };
 
     // Symbol table linking an object's name to its value
-    using Closure = std::unordered_map<std::string, ObjectHolder>;
+    using Closure = std::unordered_map<Symbol, ObjectHolder>;
 
     // Checks, if the object has the value, that reduced to True
     // If value is not zero, True and not empty string - returns true, otherwise - false.
     bool IsTrue(const ObjectHolder& object);
 
+    struct Method;
+
     // Interface for the execution with Mython objects
     class Executable {
     public:
         virtual ~Executable() = default;
 
+        // Nodes created inside an Arena::Scope are placed in its arena and freed with it, others live on the heap
+        // Destructors run either way --nodes own strings, vectors and objects that live outside the arena
+        static void* operator new(size_t size);
+        static void operator delete(void* p);
+
         // Execute an action over objects inside closure, using context
         // Returns a summary or None
         virtual ObjectHolder Execute(Closure& closure, Context& context) = 0;
+
+        // Runs the executable as the body of method called on self --binds self and actual_args to the formal
+        // params in a new closure and executes. Bodies keeping locals elsewhere override it to skip the closure
+        virtual ObjectHolder ExecuteMethod(const Method& method, const ObjectHolder& self,
+                                           const std::vector<ObjectHolder>& actual_args, Context& context);
     };
 
     // String value
@@ -115,9 +130,9 @@ namespace runtime {
 
     // Class method
     struct Method {
-        std::string name;
+        Symbol name;
         // Formal params name
-        std::vector<std::string> formal_params;
+        std::vector<Symbol> formal_params;
         // Method's body
         std::unique_ptr<Executable> body;
     };
@@ -130,11 +145,14 @@ namespace runtime {
         explicit Class(std::string name, std::vector<Method> methods, const Class* parent);
 
         // Returns method pointer or nullptr, if no method name was found
-        [[nodiscard]] const Method* GetMethod(const std::string& name) const;
+        [[nodiscard]] const Method* GetMethod(Symbol name) const;
 
         // Returns class name
         [[nodiscard]] const std::string& GetName() const;
 
+        // Methods the class declares itself, without inherited ones --passes rewrite their bodies in place
+        std::vector<Method>& GetOwnMethods();
+
         // Output string "Class <class name>", example: "Class cat"
         void Print(std::ostream& os, Context& context) override;
 
@@ -142,7 +160,7 @@ namespace runtime {
         const Class* parent_;
         std::string name_;
         std::vector<Method> methods_;
-        std::map<std::string_view, const Method*> methods_parts_;
+        std::unordered_map<Symbol, const Method*> methods_parts_;
     };
 
     // Class instance
@@ -156,10 +174,10 @@ namespace runtime {
 
         // Calls object method, with actual_args params. Param context set the context for the method execution.
         // If class or parents contain no such method, it throws exception runtime_error
-        ObjectHolder Call(const std::string& method, const std::vector<ObjectHolder>& actual_args,  Context& context);
+        ObjectHolder Call(Symbol method, const std::vector<ObjectHolder>& actual_args,  Context& context);
 
         // Returns true, if object has --method, that accepts argument_count params
-        [[nodiscard]] bool HasMethod(const std::string& method, size_t argument_count) const;
+        [[nodiscard]] bool HasMethod(Symbol method, size_t argument_count) const;
 
         // Returns Closure pointer, that contains object's fields
         [[nodiscard]] Closure& Fields();
@@ -167,11 +185,30 @@ namespace runtime {
         // Returns const Closure pointer, that contains object's fields
         [[nodiscard]] const Closure& Fields() const;
 
+        [[nodiscard]] const Class& GetClass() const {
+            return cls_;
+        }
+
     private:
         Closure fields_;
         const Class& cls_;
     };
 
+    // Comparison operators of the language
+    enum class CompareOp : uint8_t {
+        Equal,
+        NotEqual,
+        Less,
+        Greater,
+        LessOrEqual,
+        GreaterOrEqual,
+    };
+
+    // Returns lhs <op> rhs. Two numbers, strings or Bool values are compared in place, anything else
+    // behaves like the matching function below. Instantiated for every CompareOp
+    template <CompareOp op>
+    bool Compare(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+
     //Returns true, if lhs & rhs are same numbers, strings or Bool values.
     //If lhs - with __eq__ method, func returns lhs.__eq__(rhs) call result as Bool.
     //If lhs & rhs are None, func returns true. Otherwise, throws runtime_error.
@@ -2,6 +2,8 @@
 #include "test_runner_p.h"
 
 #include <functional>
+#include <thread>
+#include <vector>
 
 using namespace std;
 
@@ -529,6 +531,69 @@ void TestClassInstance() {
     ASSERT_THROWS(instance.Call("missing_method"s, {}, ctx), runtime_error);
 }
 
+void TestSymbol() {
+    Symbol empty;
+    ASSERT_EQUAL(empty.Name(), ""sv);
+    ASSERT_EQUAL(empty, Symbol(""s));
+
+    Symbol x{"symbol_test_x"s};
+    const size_t count = InternedSymbolCount();
+    Symbol same{"symbol_test_x"sv};
+    ASSERT_EQUAL(InternedSymbolCount(), count);
+    ASSERT_EQUAL(x.Id(), same.Id());
+    ASSERT_EQUAL(x.Name().data(), same.Name().data());
+    ASSERT_EQUAL(x.Name(), "symbol_test_x"sv);
+
+    Symbol y{"symbol_test_y"};
+    ASSERT(x != y);
+    ASSERT_EQUAL(InternedSymbolCount(), count + 1);
+
+    Closure closure{{"symbol_test_x"s, ObjectHolder::Own(Number{1})}};
+    ASSERT_EQUAL(closure.count(x), 1U);
+    ASSERT_EQUAL(closure.count(y), 0U);
+
+    // Local tables of several threads map the same names to the same process-wide symbols
+    vector<string> names;
+    for (int i = 0; i < 1000; ++i) {
+        names.push_back("symbol_test_local_"s + to_string(i));
+    }
+    vector<vector<Symbol>> merged(4);
+    vector<thread> threads;
+    for (auto& symbols : merged) {
+        threads.emplace_back([&names, &symbols] {
+            LocalSymbolTable local;
+            vector<Symbol> local_symbols;
+            for (int round = 0; round < 2; ++round) {
+                for (const string& name : names) {
+                    local_symbols.push_back(local.Intern(name));
+                }
+            }
+            vector<Symbol> global = local.Merge();
+            for (Symbol symbol : local_symbols) {
+                symbols.push_back(global[symbol.Id()]);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQUAL(InternedSymbolCount(), count + 1 + names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        Symbol expected{names[i]};
+        for (const auto& symbols : merged) {
+            ASSERT_EQUAL(symbols[i], expected);
+            ASSERT_EQUAL(symbols[i + names.size()], expected);
+        }
+    }
+
+    LocalSymbolTable local;
+    Symbol local_x = local.Intern("symbol_test_x"sv);
+    ASSERT_EQUAL(local_x.Name(), "symbol_test_x"sv);
+    ASSERT_EQUAL(local_x, local.Intern("symbol_test_x"s));
+    ASSERT_EQUAL(local.Intern(""sv), empty);
+    ASSERT_EQUAL(local.Merge()[local_x.Id()], x);
+}
+
 }  // namespace
 
 void RunObjectsTests(TestRunner& tr) {
@@ -540,6 +605,7 @@ void RunObjectsTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestComparison);
     RUN_TEST(tr, runtime::TestClass);
     RUN_TEST(tr, runtime::TestClassInstance);
+    RUN_TEST(tr, runtime::TestSymbol);
 }
 
 void RunObjectHolderTests(TestRunner& tr) {
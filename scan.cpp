@@ -0,0 +1,194 @@
+#include "scan.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MYTHON_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace parse::scan {
+
+    namespace {
+        const char* SkipSpacesScalar(const char* begin, const char* end) {
+            while (begin != end && *begin == ' ') {
+                ++begin;
+            }
+            return begin;
+        }
+
+        // Blank skipping loops only move line_start forward, the public kernels reset it to begin first
+        const char* SkipBlankLoopScalar(const char* begin, const char* end, const char** line_start) {
+            while (begin != end && (*begin == ' ' || *begin == '\n')) {
+                if (*begin++ == '\n') {
+                    *line_start = begin;
+                }
+            }
+            return begin;
+        }
+
+        const char* SkipBlankScalar(const char* begin, const char* end, const char** line_start) {
+            *line_start = begin;
+            return SkipBlankLoopScalar(begin, end, line_start);
+        }
+
+        const char* FindLineEndScalar(const char* begin, const char* end) {
+            while (begin != end && *begin != '\n') {
+                ++begin;
+            }
+            return begin;
+        }
+
+        constexpr Kernels SCALAR{"scalar", SkipSpacesScalar, SkipBlankScalar, FindLineEndScalar};
+
+#ifdef MYTHON_SCAN_X86
+        // Each SIMD kernel compares a whole block, turns the byte compare into a bit mask
+        // and stops at the lowest set bit --the tail shorter than a block is left to the scalar kernel
+
+        // Moves line_start after the highest newline bit of a block
+        inline void UpdateLineStart(const char* block, unsigned newline_mask, const char** line_start) {
+            if (newline_mask != 0) {
+                *line_start = block + (31 - __builtin_clz(newline_mask)) + 1;
+            }
+        }
+
+        const char* SkipSpacesSse2(const char* begin, const char* end) {
+            const __m128i spaces = _mm_set1_epi8(' ');
+            while (end - begin >= 16) {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+                unsigned stop = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, spaces))) & 0xFFFFu;
+                if (stop != 0) {
+                    return begin + __builtin_ctz(stop);
+                }
+                begin += 16;
+            }
+            return SkipSpacesScalar(begin, end);
+        }
+
+        const char* SkipBlankLoopSse2(const char* begin, const char* end, const char** line_start) {
+            const __m128i spaces = _mm_set1_epi8(' ');
+            const __m128i newlines = _mm_set1_epi8('\n');
+            while (end - begin >= 16) {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+                auto newline_mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newlines)));
+                auto space_mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, spaces)));
+                unsigned stop = ~(newline_mask | space_mask) & 0xFFFFu;
+                if (stop != 0) {
+                    UpdateLineStart(begin, newline_mask & ((1u << __builtin_ctz(stop)) - 1), line_start);
+                    return begin + __builtin_ctz(stop);
+                }
+                UpdateLineStart(begin, newline_mask, line_start);
+                begin += 16;
+            }
+            return SkipBlankLoopScalar(begin, end, line_start);
+        }
+
+        const char* SkipBlankSse2(const char* begin, const char* end, const char** line_start) {
+            *line_start = begin;
+            return SkipBlankLoopSse2(begin, end, line_start);
+        }
+
+        const char* FindLineEndSse2(const char* begin, const char* end) {
+            const __m128i newlines = _mm_set1_epi8('\n');
+            while (end - begin >= 16) {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+                auto stop = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newlines)));
+                if (stop != 0) {
+                    return begin + __builtin_ctz(stop);
+                }
+                begin += 16;
+            }
+            return FindLineEndScalar(begin, end);
+        }
+
+        __attribute__((target("avx2"))) const char* SkipSpacesAvx2(const char* begin, const char* end) {
+            const __m256i spaces = _mm256_set1_epi8(' ');
+            while (end - begin >= 32) {
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+                unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, spaces)));
+                if (stop != 0) {
+                    return begin + __builtin_ctz(stop);
+                }
+                begin += 32;
+            }
+            return SkipSpacesSse2(begin, end);
+        }
+
+        __attribute__((target("avx2"))) const char* SkipBlankAvx2(const char* begin, const char* end, const char** line_start) {
+            *line_start = begin;
+            const __m256i spaces = _mm256_set1_epi8(' ');
+            const __m256i newlines = _mm256_set1_epi8('\n');
+            while (end - begin >= 32) {
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+                auto newline_mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newlines)));
+                auto space_mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, spaces)));
+                unsigned stop = ~(newline_mask | space_mask);
+                if (stop != 0) {
+                    UpdateLineStart(begin, newline_mask & ((1u << __builtin_ctz(stop)) - 1), line_start);
+                    return begin + __builtin_ctz(stop);
+                }
+                UpdateLineStart(begin, newline_mask, line_start);
+                begin += 32;
+            }
+            return SkipBlankLoopSse2(begin, end, line_start);
+        }
+
+        __attribute__((target("avx2"))) const char* FindLineEndAvx2(const char* begin, const char* end) {
+            const __m256i newlines = _mm256_set1_epi8('\n');
+            while (end - begin >= 32) {
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+                auto stop = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newlines)));
+                if (stop != 0) {
+                    return begin + __builtin_ctz(stop);
+                }
+                begin += 32;
+            }
+            return FindLineEndSse2(begin, end);
+        }
+
+        constexpr Kernels SSE2{"sse2", SkipSpacesSse2, SkipBlankSse2, FindLineEndSse2};
+        constexpr Kernels AVX2{"avx2", SkipSpacesAvx2, SkipBlankAvx2, FindLineEndAvx2};
+
+        bool HasSse2() {
+#if defined(__x86_64__) || defined(__SSE2__)
+            return true; // part of x86-64 baseline
+#else
+            return __builtin_cpu_supports("sse2");
+#endif
+        }
+
+        bool HasAvx2() {
+            return __builtin_cpu_supports("avx2");
+        }
+#endif
+
+        const Kernels& SelectKernels() {
+#ifdef MYTHON_SCAN_X86
+            if (HasAvx2()) {
+                return AVX2;
+            }
+            if (HasSse2()) {
+                return SSE2;
+            }
+#endif
+            return SCALAR;
+        }
+    }  // namespace
+
+    const Kernels& Active() {
+        static const Kernels& kernels = SelectKernels();
+        return kernels;
+    }
+
+    std::vector<const Kernels*> Available() {
+        std::vector<const Kernels*> result{&SCALAR};
+#ifdef MYTHON_SCAN_X86
+        if (HasSse2()) {
+            result.push_back(&SSE2);
+        }
+        if (HasAvx2()) {
+            result.push_back(&AVX2);
+        }
+#endif
+        return result;
+    }
+
+}  // namespace parse::scan
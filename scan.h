@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+namespace parse::scan {
+
+    // Set of skipping kernels over a contiguous source range [begin, end)
+    // Each kernel returns the first position that stops the skip or end
+    struct Kernels {
+        const char* name;
+        const char* (*skip_spaces)(const char* begin, const char* end); // first char that isn't ' '
+        // first char that isn't ' ' or '\n', line_start gets the position after the last skipped '\n' or begin
+        const char* (*skip_blank)(const char* begin, const char* end, const char** line_start);
+        const char* (*find_line_end)(const char* begin, const char* end); // first '\n'
+    };
+
+    // Returns the widest kernels this CPU supports --AVX2, SSE2 or scalar, chosen once at first call
+    const Kernels& Active();
+
+    // Returns all kernels this CPU can run, scalar first --for tests and benchmarks
+    std::vector<const Kernels*> Available();
+
+    inline const char* SkipSpaces(const char* begin, const char* end) {
+        return Active().skip_spaces(begin, end);
+    }
+
+    inline const char* SkipBlank(const char* begin, const char* end, const char** line_start) {
+        return Active().skip_blank(begin, end, line_start);
+    }
+
+    inline const char* FindLineEnd(const char* begin, const char* end) {
+        return Active().find_line_end(begin, end);
+    }
+
+}  // namespace parse::scan
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace parse {
+
+    // Bounded ring for exactly one producer thread and one consumer thread
+    // Capacity must be a power of two --indexes grow forever and are masked on access
+    // TryPush and TryPop are lock-free: two atomic indexes, no mutex. Push and Pop wait for the other side:
+    // they spin a few rounds, then sleep on a mutex and condition variable until it moves or a short slice
+    // passes, so a stalled producer or consumer doesn't keep a core busy. The mutex is taken only to sleep
+    // and to wake a sleeper, never while the ring keeps moving
+    template <typename T, size_t Capacity>
+    class SpscQueue {
+        static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        // Producer side --waits for a free slot, returns false and leaves value untouched once cancel is set
+        // The thread setting cancel must call WakeAll after it
+        bool Push(T&& value, const std::atomic<bool>& cancel) {
+            for (int round = 0; round < kSpinRounds; ++round) {
+                if (TryPush(std::move(value))) {
+                    return true;
+                }
+                if (cancel.load(std::memory_order_acquire)) {
+                    return false;
+                }
+                std::this_thread::yield();
+            }
+            bool pushed = false;
+            Sleep(producer_waiting_, [&] { // waking for every single free slot would cost a syscall per value
+                pushed = IsHalfFree() && PushNoWake(std::move(value));
+                return pushed || cancel.load(std::memory_order_acquire);
+            });
+            if (pushed) {
+                WakeIfWaiting(consumer_waiting_);
+            }
+            return pushed;
+        }
+
+        // Consumer side --waits for the next value and moves it into out
+        void Pop(T& out) {
+            for (int round = 0; round < kSpinRounds; ++round) {
+                if (TryPop(out)) {
+                    return;
+                }
+                std::this_thread::yield();
+            }
+            Sleep(consumer_waiting_, [&] { return PopNoWake(out); });
+            WakeProducerIfHalfFree();
+        }
+
+        // Wakes a side sleeping in Push or Pop so it checks its condition again
+        void WakeAll() {
+            std::lock_guard lock(mutex_);
+            moved_.notify_all();
+        }
+
+        // Producer side --returns false and leaves value untouched if the ring is full
+        bool TryPush(T&& value) {
+            if (!PushNoWake(std::move(value))) {
+                return false;
+            }
+            WakeIfWaiting(consumer_waiting_);
+            return true;
+        }
+
+        // Consumer side --moves the oldest value into out, returns false if the ring is empty
+        bool TryPop(T& out) {
+            if (!PopNoWake(out)) {
+                return false;
+            }
+            WakeProducerIfHalfFree();
+            return true;
+        }
+
+    private:
+        static constexpr size_t kCacheLine = 64;
+        static constexpr int kSpinRounds = 64; // yields before a waiting side goes to sleep
+        static constexpr std::chrono::milliseconds kSleepSlice{1};
+
+        // TryPush and TryPop without waking the other side --Sleep calls them with the mutex held
+        bool PushNoWake(T&& value) {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_cache_ == Capacity) {
+                head_cache_ = head_.load(std::memory_order_acquire); // re-read consumer index only when looking full
+                if (tail - head_cache_ == Capacity) {
+                    return false;
+                }
+            }
+            slots_[tail & (Capacity - 1)] = std::move(value);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool PopNoWake(T& out) {
+            size_t head = head_.load(std::memory_order_relaxed);
+            if (head == tail_cache_) {
+                tail_cache_ = tail_.load(std::memory_order_acquire); // re-read producer index only when looking empty
+                if (head == tail_cache_) {
+                    return false;
+                }
+            }
+            out = std::move(slots_[head & (Capacity - 1)]);
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Sleeps until ready returns true, checking it again every kSleepSlice
+        // The other side reads waiting with no fence after it moves its index --a full fence on every push and pop
+        // would cost more than the pipeline saves. It may miss a sleeper that raised waiting right then, the slice
+        // bounds how long such a sleeper stays behind
+        template <typename Ready>
+        void Sleep(std::atomic<bool>& waiting, Ready ready) {
+            std::unique_lock lock(mutex_);
+            waiting.store(true, std::memory_order_seq_cst);
+            while (!ready()) {
+                moved_.wait_for(lock, kSleepSlice);
+            }
+            waiting.store(false, std::memory_order_relaxed);
+        }
+
+        void WakeIfWaiting(const std::atomic<bool>& waiting) {
+            if (waiting.load(std::memory_order_relaxed)) {
+                WakeAll(); // the sleeper holds the mutex until it waits, so the notify can't come too early
+            }
+        }
+
+        // A sleeping producer waits for half of the ring, so it is woken once per half, not per popped value
+        bool IsHalfFree() const {
+            return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_acquire) <= Capacity / 2;
+        }
+
+        void WakeProducerIfHalfFree() {
+            if (producer_waiting_.load(std::memory_order_relaxed)
+                && tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_relaxed) <= Capacity / 2) {
+                WakeAll();
+            }
+        }
+
+        // Indexes written by different threads live on separate cache lines
+        alignas(kCacheLine) std::atomic<size_t> head_{0}; // next slot to pop, written by consumer
+        size_t tail_cache_ = 0; // consumer's copy of tail_
+        alignas(kCacheLine) std::atomic<size_t> tail_{0}; // next slot to push, written by producer
+        size_t head_cache_ = 0; // producer's copy of head_
+        alignas(kCacheLine) std::array<T, Capacity> slots_;
+        alignas(kCacheLine) std::atomic<bool> producer_waiting_{false}; // set while Push sleeps on a full ring
+        std::atomic<bool> consumer_waiting_{false}; // set while Pop sleeps on an empty ring
+        std::mutex mutex_;
+        std::condition_variable moved_;
+    };
+
+}  // namespace parse
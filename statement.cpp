@@ -1,5 +1,6 @@
 #include "statement.h"
 
+#include <array>
 #include <iostream>
 #include <utility>
 
@@ -12,21 +13,27 @@ namespace ast {
     using runtime::ObjectHolder;
 
     namespace {
-        [[maybe_unused]] const string ADD_METHOD = "__add__"s;
-        [[maybe_unused]] const string INIT_METHOD = "__init__"s;
+        [[maybe_unused]] const runtime::Symbol ADD_METHOD{"__add__"};
+        [[maybe_unused]] const runtime::Symbol INIT_METHOD{"__init__"};
+
+        // Self and arguments of the innermost InlinedCall running on this thread --an operator of its body may call
+        // a method running other InlinedCalls, each of them restores the pointer it found
+        thread_local const ObjectHolder* inlined_arguments = nullptr;
     }  // namespace
 
     ObjectHolder Assignment::Execute(Closure& closure, Context& context) {
         return closure[var_] = std::move(rv_->Execute(closure, context));
     }
 
-    Assignment::Assignment(std::string var, std::unique_ptr<Statement> rv): var_(std::move(var)), rv_(move(rv)){}
+    Assignment::Assignment(runtime::Symbol var, std::unique_ptr<Statement> rv): var_(var), rv_(move(rv)){}
 
-    VariableValue::VariableValue(std::string  var_name) {
-        dotted_ids_.push_back(std::move(var_name));
+    VariableValue::VariableValue(runtime::Symbol var_name) {
+        dotted_ids_.push_back(var_name);
     }
 
-    VariableValue::VariableValue(std::vector<std::string>  dotted_ids): dotted_ids_(std::move(dotted_ids)) {}
+    VariableValue::VariableValue(std::vector<runtime::Symbol> dotted_ids): dotted_ids_(std::move(dotted_ids)) {}
+
+    VariableValue::VariableValue(const std::vector<std::string>& dotted_ids): dotted_ids_(dotted_ids.begin(), dotted_ids.end()) {}
 
     ObjectHolder VariableValue::Execute(Closure& closure, [[maybe_unused]] Context& context) {
         Closure* local_closer = &closure;
@@ -50,7 +57,7 @@ namespace ast {
 
     Print::Print(std::vector<std::unique_ptr<Statement>> args):args_(std::move(args))  {}
 
-    unique_ptr<Print> Print::Variable(const std::string& name) {
+    unique_ptr<Print> Print::Variable(runtime::Symbol name) {
         return std::make_unique<Print>(std::make_unique<VariableValue>(name));
     }
 
@@ -74,8 +81,8 @@ namespace ast {
         return object_holder;
     }
 
-    MethodCall::MethodCall(std::unique_ptr<Statement> object, std::string method, std::vector<std::unique_ptr<Statement>> args):
-            object_(move(object)), method_(std::move(method)), args_(std::move(args)) {}
+    MethodCall::MethodCall(std::unique_ptr<Statement> object, runtime::Symbol method, std::vector<std::unique_ptr<Statement>> args):
+            object_(move(object)), method_(method), args_(std::move(args)) {}
 
     ObjectHolder MethodCall::Execute(Closure& closure, Context& context) {
         std::vector<runtime::ObjectHolder> actual_args;
@@ -134,7 +141,7 @@ namespace ast {
         auto holder_lhs = lhs_->Execute(closure, context);
         auto holder_rhs = rhs_->Execute(closure, context);
         if (holder_lhs.TryAs<runtime::Number>() != nullptr && holder_rhs.TryAs<runtime::Number>() != nullptr) {
-            if (holder_rhs.TryAs<runtime::Number>() != nullptr){ //??
+            if (holder_rhs.TryAs<runtime::Number>()->GetValue() != 0) {
                 return ObjectHolder::Own(runtime::Number(holder_lhs.TryAs<runtime::Number>()->GetValue() / holder_rhs.TryAs<runtime::Number>()->GetValue()));
             } else {
                 throw std::runtime_error("Execute(): DIV --runtime_error --division by zero"s);
@@ -157,11 +164,11 @@ namespace ast {
     ClassDefinition::ClassDefinition(ObjectHolder cls): cls_(std::move(cls)) {}
 
     ObjectHolder ClassDefinition::Execute(Closure& closure, [[maybe_unused]] Context& context) {
-        return closure[cls_.TryAs<runtime::Class>()->GetName()] = std::move(cls_);
+        return closure[cls_.TryAs<runtime::Class>()->GetName()] = cls_; // copy keeps the definition executable again
     }
 
-    FieldAssignment::FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<Statement> rv):
-            object_(std::move(object)), field_name_(std::move(field_name)), rv_(std::move(rv)){}
+    FieldAssignment::FieldAssignment(VariableValue object, runtime::Symbol field_name, std::unique_ptr<Statement> rv):
+            object_(std::move(object)), field_name_(field_name), rv_(std::move(rv)){}
 
     ObjectHolder FieldAssignment::Execute(Closure& closure, Context& context) {
         return object_.Execute(closure, context).TryAs<runtime::ClassInstance>()->Fields()[field_name_] = std::move(rv_->Execute(closure, context));
@@ -197,6 +204,14 @@ namespace ast {
         return ObjectHolder::Own(runtime::Bool(!IsTrue(argument_->Execute(closure, context))));
     }
 
+    ObjectHolder Negate::Execute(Closure& closure, Context& context) {
+        auto holder = argument_->Execute(closure, context);
+        if (const auto* number = holder.TryAs<runtime::Number>()) {
+            return ObjectHolder::Own(runtime::Number(-number->GetValue()));
+        }
+        throw std::runtime_error("Execute(): NEGATE --runtime_error"s);
+    }
+
     Comparison::Comparison(Comparator cmp, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs):
             BinaryOperation(std::move(lhs), std::move(rhs)), cmp_(std::move(cmp)) {}
 
@@ -205,24 +220,65 @@ namespace ast {
         return ObjectHolder::Own(runtime::Bool(result));
     }
 
+    template <runtime::CompareOp op>
+    ObjectHolder ComparisonOf<op>::Execute(Closure& closure, Context& context) {
+        ObjectHolder lhs = lhs_->Execute(closure, context);
+        return ObjectHolder::Own(runtime::Bool(runtime::Compare<op>(lhs, rhs_->Execute(closure, context), context)));
+    }
+
+    template class ComparisonOf<runtime::CompareOp::Equal>;
+    template class ComparisonOf<runtime::CompareOp::NotEqual>;
+    template class ComparisonOf<runtime::CompareOp::Less>;
+    template class ComparisonOf<runtime::CompareOp::Greater>;
+    template class ComparisonOf<runtime::CompareOp::LessOrEqual>;
+    template class ComparisonOf<runtime::CompareOp::GreaterOrEqual>;
+
     NewInstance::NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args):
-            class_instance_(class_), args_(std::move(args)){}
+            class_(class_), args_(std::move(args)){}
 
-    NewInstance::NewInstance(const runtime::Class& class_): class_instance_(class_) {}
+    NewInstance::NewInstance(const runtime::Class& class_): class_(class_) {}
 
     ObjectHolder NewInstance::Execute(Closure& closure, Context& context) {
-        if (class_instance_.HasMethod(INIT_METHOD, args_.size())) {
+        ObjectHolder instance = ObjectHolder::Own(runtime::ClassInstance(class_)); // statement may run many times --each run is a new object
+        auto* class_instance = instance.TryAs<runtime::ClassInstance>();
+        if (class_instance->HasMethod(INIT_METHOD, args_.size())) {
             std::vector <runtime::ObjectHolder> args;
             for (const auto& arg : args_) {
                 args.push_back(arg->Execute(closure, context));
             }
-            class_instance_.Call(INIT_METHOD, args, context);
+            class_instance->Call(INIT_METHOD, args, context);
         }
-        return runtime::ObjectHolder::Share(class_instance_);
+        return instance;
     }
 
     MethodBody::MethodBody(std::unique_ptr<Statement>&& body): body_(std::move(body)) {}
 
+    LazyMethodBody::LazyMethodBody(Parser parse): parse_(std::move(parse)) {}
+
+    ObjectHolder LazyMethodBody::Execute(Closure& closure, Context& context) {
+        return GetBody()->Execute(closure, context);
+    }
+
+    ObjectHolder LazyMethodBody::ExecuteMethod(const runtime::Method& method, const ObjectHolder& self,
+                                               const std::vector<ObjectHolder>& actual_args, Context& context) {
+        return GetBody()->ExecuteMethod(method, self, actual_args, context);
+    }
+
+    std::unique_ptr<Statement>& LazyMethodBody::GetBody() {
+        if (!body_) {
+            body_ = parse_();
+            parse_ = nullptr;
+        }
+        return body_;
+    }
+
+    Program::Program(std::shared_ptr<runtime::Arena> arena, std::unique_ptr<Statement> body)
+            : arena_(std::move(arena)), body_(std::move(body)) {}
+
+    ObjectHolder Program::Execute(Closure& closure, Context& context) {
+        return body_->Execute(closure, context);
+    }
+
     ObjectHolder MethodBody::Execute(Closure& closure, Context& context) {
         try {
             body_->Execute(closure, context);
@@ -232,4 +288,67 @@ namespace ast {
         return {};
     }
 
-}  // namespace ast
\ No newline at end of file
+    InlinedCall::InlinedCall(std::unique_ptr<MethodCall> call, const runtime::Class& cls, std::unique_ptr<Statement> body,
+                             bool returns_value):
+            call_(std::move(call)), cls_(cls), body_(std::move(body)), returns_value_(returns_value) {}
+
+    ObjectHolder InlinedCall::Execute(Closure& closure, Context& context) {
+        auto& args = call_->GetArgs();
+        std::array<ObjectHolder, MAX_PARAMS + 1> arguments; // no closure, no allocation
+        for (size_t i = 0; i < args.size(); ++i) {
+            arguments[i + 1] = args[i]->Execute(closure, context);
+        }
+        arguments[0] = call_->GetObject()->Execute(closure, context);
+        auto* instance = arguments[0].TryAs<runtime::ClassInstance>();
+        if (instance == nullptr) {
+            throw std::runtime_error("InlinedCall::Execute(): method called on a non-object"s);
+        }
+        if (&instance->GetClass() != &cls_) { // the method may differ, say overridden by a subclass
+            return instance->Call(call_->GetMethod(), {arguments.begin() + 1, arguments.begin() + 1 + args.size()}, context);
+        }
+
+        const ObjectHolder* previous = std::exchange(inlined_arguments, arguments.data());
+        ObjectHolder result;
+        try {
+            result = body_->Execute(closure, context);
+        } catch (...) {
+            inlined_arguments = previous;
+            throw;
+        }
+        inlined_arguments = previous;
+        return returns_value_ ? result : ObjectHolder{};
+    }
+
+    InlinedArgument::InlinedArgument(size_t index, std::vector<runtime::Symbol> fields):
+            index_(index), fields_(std::move(fields)) {}
+
+    ObjectHolder InlinedArgument::Execute([[maybe_unused]] Closure& closure, [[maybe_unused]] Context& context) {
+        const ObjectHolder* value = &inlined_arguments[index_];
+        for (runtime::Symbol field : fields_) {
+            auto* instance = value->TryAs<runtime::ClassInstance>();
+            if (instance == nullptr) {
+                throw std::runtime_error("InlinedArgument::Execute(): field of a non-object"s);
+            }
+            auto it = instance->Fields().find(field);
+            if (it == instance->Fields().end()) {
+                throw std::runtime_error("InlinedArgument::Execute(): unknown field "s + string(field.Name()));
+            }
+            value = &it->second;
+        }
+        return *value;
+    }
+
+    InlinedFieldAssignment::InlinedFieldAssignment(std::unique_ptr<Statement> object, runtime::Symbol field_name,
+                                                   std::unique_ptr<Statement> rv):
+            object_(std::move(object)), field_name_(field_name), rv_(std::move(rv)) {}
+
+    ObjectHolder InlinedFieldAssignment::Execute(Closure& closure, Context& context) {
+        ObjectHolder value = rv_->Execute(closure, context); // value first, like FieldAssignment
+        auto* instance = object_->Execute(closure, context).TryAs<runtime::ClassInstance>();
+        if (instance == nullptr) {
+            throw std::runtime_error("InlinedFieldAssignment::Execute(): field assignment to a non-object"s);
+        }
+        return instance->Fields()[field_name_] = std::move(value);
+    }
+
+}  // namespace ast
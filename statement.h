@@ -1,5 +1,6 @@
 #pragma once
 
+#include "arena.h"
 #include "runtime.h"
 
 #include <functional>
@@ -18,6 +19,10 @@ namespace ast {
             return runtime::ObjectHolder::Share(value_);
         }
 
+        [[nodiscard]] const T& GetValue() const {
+            return value_;
+        }
+
     private:
         T value_;
     };
@@ -30,38 +35,63 @@ namespace ast {
     // An example circle.center.x - object field call chain in instruction: x = circle.center.x
     class VariableValue : public Statement {
     private:
-        std::vector<std::string> dotted_ids_;
+        std::vector<runtime::Symbol> dotted_ids_;
 
     public:
-        explicit VariableValue(std::string  var_name);
-        explicit VariableValue(std::vector<std::string>  dotted_ids);
+        explicit VariableValue(runtime::Symbol var_name);
+        explicit VariableValue(std::vector<runtime::Symbol> dotted_ids);
+        explicit VariableValue(const std::vector<std::string>& dotted_ids);
 
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const std::vector<runtime::Symbol>& GetDottedIds() const {
+            return dotted_ids_;
+        }
     };
 
     // Assigns the variable var to the value of the rv expression
     class Assignment : public Statement {
     private:
-        std::string var_;
+        runtime::Symbol var_;
         std::unique_ptr<Statement> rv_;
 
     public:
-        Assignment(std::string var, std::unique_ptr<Statement> rv);
+        Assignment(runtime::Symbol var, std::unique_ptr<Statement> rv);
 
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] runtime::Symbol GetVar() const {
+            return var_;
+        }
+
+        std::unique_ptr<Statement>& GetRv() {
+            return rv_;
+        }
     };
 
     // Assigns field object.field_name to the value of the rv expression
     class FieldAssignment : public Statement {
     private:
         VariableValue object_;
-        std::string field_name_;
+        runtime::Symbol field_name_;
         std::unique_ptr<Statement> rv_;
 
     public:
-        FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<Statement> rv);
+        FieldAssignment(VariableValue object, runtime::Symbol field_name, std::unique_ptr<Statement> rv);
 
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const VariableValue& GetObject() const {
+            return object_;
+        }
+
+        [[nodiscard]] runtime::Symbol GetFieldName() const {
+            return field_name_;
+        }
+
+        std::unique_ptr<Statement>& GetRv() {
+            return rv_;
+        }
     };
 
     // Value None
@@ -81,11 +111,15 @@ namespace ast {
         explicit Print(std::vector<std::unique_ptr<Statement>> args);
 
         // Initializes the print command to output name variable
-        static std::unique_ptr<Print> Variable(const std::string& name);
+        static std::unique_ptr<Print> Variable(runtime::Symbol name);
 
         // While print execution output has to be into stream that returns from context.GetOutputStream()
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        std::vector<std::unique_ptr<Statement>>& GetArgs() {
+            return args_;
+        }
+
     private:
         std::vector<std::unique_ptr<Statement>> args_;
     };
@@ -94,13 +128,25 @@ namespace ast {
     class MethodCall : public Statement {
     private:
         std::unique_ptr<Statement> object_;
-        std::string method_; // name
+        runtime::Symbol method_; // name
         std::vector<std::unique_ptr<Statement>> args_;
 
     public:
-        MethodCall(std::unique_ptr<Statement> object, std::string method, std::vector<std::unique_ptr<Statement>> args);
+        MethodCall(std::unique_ptr<Statement> object, runtime::Symbol method, std::vector<std::unique_ptr<Statement>> args);
 
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        std::unique_ptr<Statement>& GetObject() {
+            return object_;
+        }
+
+        [[nodiscard]] runtime::Symbol GetMethod() const {
+            return method_;
+        }
+
+        std::vector<std::unique_ptr<Statement>>& GetArgs() {
+            return args_;
+        }
     };
 
     /*
@@ -113,15 +159,23 @@ namespace ast {
     */
     class NewInstance : public Statement {
     private:
-        runtime::ClassInstance class_instance_;
+        const runtime::Class& class_;
         std::vector<std::unique_ptr<Statement>> args_;
 
     public:
         explicit NewInstance(const runtime::Class& class_);
         NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args);
 
-        // returns object that has value of ClassInstance type
+        // returns new object of ClassInstance type on every execution
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const runtime::Class& GetClass() const {
+            return class_;
+        }
+
+        std::vector<std::unique_ptr<Statement>>& GetArgs() {
+            return args_;
+        }
     };
 
     // Unary operations base class
@@ -130,6 +184,10 @@ namespace ast {
         std::unique_ptr<Statement> argument_;
     public:
         explicit UnaryOperation(std::unique_ptr<Statement> argument): argument_(std::move(argument)) {}
+
+        std::unique_ptr<Statement>& GetArgument() {
+            return argument_;
+        }
     };
 
     // Operation str returns value of own arg
@@ -145,6 +203,14 @@ namespace ast {
         BinaryOperation(std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs):
         lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
 
+        std::unique_ptr<Statement>& GetLhs() {
+            return lhs_;
+        }
+
+        std::unique_ptr<Statement>& GetRhs() {
+            return rhs_;
+        }
+
     protected:
         std::unique_ptr<Statement> lhs_;
         std::unique_ptr<Statement> rhs_;
@@ -213,6 +279,15 @@ namespace ast {
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
     };
 
+    // Unary minus --the parser writes it as a multiplication by -1, optimization turns that into Negate
+    class Negate : public UnaryOperation {
+    public:
+        using UnaryOperation::UnaryOperation;
+
+        // Supports numbers only, otherwise throws runtime_error
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    };
+
     // Compound instruction --example: method body, contents of if or else branch
     class Compound : public Statement {
     public:
@@ -232,6 +307,10 @@ namespace ast {
         // Executes the added instruction within query. Returns None
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        std::vector<std::unique_ptr<Statement>>& GetStatements() {
+            return args_;
+        }
+
     private:
         std::vector<std::unique_ptr<Statement>> args_;
 
@@ -245,15 +324,68 @@ namespace ast {
     };
 
     // Method Body. As usual, contains compound instruction
+    // Lives on the heap even inside an Arena::Scope and keeps the scope's arena alive --
+    // its class may outlive the program the method was parsed in
     class MethodBody : public Statement {
     private:
+        std::shared_ptr<runtime::Arena> arena_ = runtime::Arena::Current(); // destroyed after body_
         std::unique_ptr<Statement> body_;
 
     public:
         explicit MethodBody(std::unique_ptr<Statement>&& body);
 
+        static void* operator new(size_t size) {
+            return ::operator new(size);
+        }
+
+        static void operator delete(void* p) {
+            ::operator delete(p);
+        }
+
         // Calculates instruction that passed as body. If body has return, returns result. Else returns None
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        std::unique_ptr<Statement>& GetBody() {
+            return body_;
+        }
+
+        [[nodiscard]] const std::shared_ptr<runtime::Arena>& GetArena() const {
+            return arena_;
+        }
+    };
+
+    // Method body that isn't parsed until the method is first run --parse builds the MethodBody then
+    // Lives on the heap like MethodBody, parse keeps whatever the parsing needs alive
+    class LazyMethodBody : public Statement {
+    public:
+        using Parser = std::function<std::unique_ptr<Statement>()>;
+
+        explicit LazyMethodBody(Parser parse);
+
+        static void* operator new(size_t size) {
+            return ::operator new(size);
+        }
+
+        static void operator delete(void* p) {
+            ::operator delete(p);
+        }
+
+        // Both parse the body on the first run, a ParseError of the body is thrown then and on every later run
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+        runtime::ObjectHolder ExecuteMethod(const runtime::Method& method, const runtime::ObjectHolder& self,
+                                            const std::vector<runtime::ObjectHolder>& actual_args,
+                                            runtime::Context& context) override;
+
+        [[nodiscard]] bool IsParsed() const {
+            return body_ != nullptr;
+        }
+
+        // Parses the body if it wasn't yet
+        std::unique_ptr<Statement>& GetBody();
+
+    private:
+        Parser parse_; // dropped once the body is parsed, with the tokens it holds
+        std::unique_ptr<Statement> body_;
     };
 
     // Executes return instruction with the statement
@@ -266,6 +398,30 @@ namespace ast {
 
         // Stops the method. When executed the method within it was called has to return expression statement result.
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        std::unique_ptr<Statement>& GetStatement() {
+            return statement_;
+        }
+    };
+
+    // Root of a parsed program --owns the arena its nodes were placed in and releases it after them
+    class Program : public Statement {
+    private:
+        std::shared_ptr<runtime::Arena> arena_; // destroyed after body_
+        std::unique_ptr<Statement> body_;
+
+    public:
+        Program(std::shared_ptr<runtime::Arena> arena, std::unique_ptr<Statement> body);
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        std::unique_ptr<Statement>& GetBody() {
+            return body_;
+        }
+
+        [[nodiscard]] const std::shared_ptr<runtime::Arena>& GetArena() const {
+            return arena_;
+        }
     };
 
     // Declares the class
@@ -278,6 +434,10 @@ namespace ast {
 
         // Creates a new obj inside closure that matches with name of the class and value that were passed to the constructor
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const runtime::ObjectHolder& GetClass() const {
+            return cls_;
+        }
     };
 
     // Instruction if <condition> <if_body> else <else_body>
@@ -291,6 +451,19 @@ namespace ast {
         IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> if_body, std::unique_ptr<Statement> else_body);
 
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        std::unique_ptr<Statement>& GetCondition() {
+            return condition_;
+        }
+
+        std::unique_ptr<Statement>& GetIfBody() {
+            return if_body_;
+        }
+
+        // nullptr if there is no else branch
+        std::unique_ptr<Statement>& GetElseBody() {
+            return else_body_;
+        }
     };
 
     // Comparison operation
@@ -304,8 +477,119 @@ namespace ast {
         // Calculates an expression lhs and rhs and returns a result of comparator expression that cast to the type of runtime::Bool
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        [[nodiscard]] const Comparator& GetComparator() const {
+            return cmp_;
+        }
+
     private:
         Comparator cmp_;
     };
 
-}  // namespace ast
\ No newline at end of file
+    // Comparison by one of the language operators, which the parser emits --unlike Comparison with an arbitrary
+    // Comparator it calls no std::function, see ComparisonOf
+    class BuiltinComparison : public BinaryOperation {
+    public:
+        using BinaryOperation::BinaryOperation;
+
+        [[nodiscard]] virtual runtime::CompareOp GetOp() const = 0;
+    };
+
+    // Comparison with the operator fixed at compile time --runtime::Compare<op> is called directly
+    template <runtime::CompareOp op>
+    class ComparisonOf final : public BuiltinComparison {
+    public:
+        using BuiltinComparison::BuiltinComparison;
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] runtime::CompareOp GetOp() const override {
+            return op;
+        }
+    };
+
+    // Call whose method body was substituted at the call site by ast::InlineMethods --runs the substituted body while
+    // the receiver is an instance of the class the body was taken from, otherwise makes the call as usual
+    class InlinedCall : public Statement {
+    public:
+        // self and at most MAX_PARAMS arguments, which the body reads through InlinedArgument
+        static constexpr size_t MAX_PARAMS = 3;
+
+        // The call returns the value of body if returns_value is set, None otherwise
+        InlinedCall(std::unique_ptr<MethodCall> call, const runtime::Class& cls, std::unique_ptr<Statement> body,
+                    bool returns_value);
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        // Receiver, arguments and name of the method
+        MethodCall& GetCall() {
+            return *call_;
+        }
+
+        [[nodiscard]] const runtime::Class& GetClass() const {
+            return cls_;
+        }
+
+        std::unique_ptr<Statement>& GetBody() {
+            return body_;
+        }
+
+        [[nodiscard]] bool ReturnsValue() const {
+            return returns_value_;
+        }
+
+    private:
+        std::unique_ptr<MethodCall> call_;
+        const runtime::Class& cls_;
+        std::unique_ptr<Statement> body_;
+        bool returns_value_;
+    };
+
+    // self (index 0) or a param of the innermost InlinedCall running, followed by fields of it
+    // Unlike VariableValue each field must belong to the object before it --InlineMethods copies reads of one
+    // field at most, where the two agree
+    class InlinedArgument : public Statement {
+    public:
+        InlinedArgument(size_t index, std::vector<runtime::Symbol> fields);
+
+        // Throws runtime_error if a field is missing or is asked of a value that isn't an object
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] size_t GetIndex() const {
+            return index_;
+        }
+
+        [[nodiscard]] const std::vector<runtime::Symbol>& GetFields() const {
+            return fields_;
+        }
+
+    private:
+        size_t index_;
+        std::vector<runtime::Symbol> fields_;
+    };
+
+    // FieldAssignment whose object is any expression --an inlined setter assigns a field of an InlinedArgument
+    class InlinedFieldAssignment : public Statement {
+    public:
+        InlinedFieldAssignment(std::unique_ptr<Statement> object, runtime::Symbol field_name, std::unique_ptr<Statement> rv);
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        std::unique_ptr<Statement>& GetObject() {
+            return object_;
+        }
+
+        [[nodiscard]] runtime::Symbol GetFieldName() const {
+            return field_name_;
+        }
+
+        std::unique_ptr<Statement>& GetRv() {
+            return rv_;
+        }
+
+    private:
+        std::unique_ptr<Statement> object_;
+        runtime::Symbol field_name_;
+        std::unique_ptr<Statement> rv_;
+    };
+
+}  // namespace ast
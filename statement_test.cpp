@@ -453,6 +453,52 @@ void TestNot() {
     test_not(false);
 }
 
+void TestComparisonOf() {
+    using runtime::CompareOp;
+    auto compare = [](auto&& comparison) {
+        Closure closure;
+        runtime::DummyContext context;
+        return comparison.Execute(closure, context).template TryAs<runtime::Bool>()->GetValue();
+    };
+
+    ASSERT(compare(ComparisonOf<CompareOp::Less>(make_unique<NumericConst>(2), make_unique<NumericConst>(3))));
+    ASSERT(!compare(ComparisonOf<CompareOp::Greater>(make_unique<NumericConst>(3), make_unique<NumericConst>(3))));
+    ASSERT(compare(ComparisonOf<CompareOp::GreaterOrEqual>(make_unique<NumericConst>(3), make_unique<NumericConst>(3))));
+    ASSERT(compare(ComparisonOf<CompareOp::LessOrEqual>(make_unique<StringConst>("ab"s), make_unique<StringConst>("b"s))));
+    ASSERT(compare(ComparisonOf<CompareOp::NotEqual>(make_unique<StringConst>("a"s), make_unique<StringConst>("b"s))));
+    ASSERT(compare(ComparisonOf<CompareOp::Equal>(make_unique<BoolConst>(true), make_unique<BoolConst>(true))));
+    ASSERT(compare(ComparisonOf<CompareOp::Equal>(make_unique<None>(), make_unique<None>())));
+    ASSERT_THROWS(compare(ComparisonOf<CompareOp::Less>(make_unique<NumericConst>(1), make_unique<StringConst>("1"s))),
+                  runtime_error);
+
+    // objects are compared by __lt__ and __eq__, each called only while the result is still open
+    auto logged_method = [](const string& name, bool result) {
+        auto body = make_unique<Compound>(make_unique<Print>(make_unique<StringConst>(name)),
+                                          make_unique<Return>(make_unique<BoolConst>(result)));
+        return runtime::Method{name, {"other"s}, make_unique<MethodBody>(std::move(body))};
+    };
+    vector<runtime::Method> methods;
+    methods.push_back(logged_method("__lt__"s, true));
+    methods.push_back(logged_method("__eq__"s, false));
+    runtime::Class cls("Ordered"s, std::move(methods), nullptr);
+
+    auto log = [](unique_ptr<Statement> comparison) {
+        Closure closure;
+        runtime::DummyContext context;
+        bool result = comparison->Execute(closure, context).TryAs<runtime::Bool>()->GetValue();
+        return (result ? "True "s : "False "s) + context.output.str();
+    };
+    auto instance = [&cls] {
+        return make_unique<NewInstance>(cls);
+    };
+    using Greater = ComparisonOf<CompareOp::Greater>;
+    using LessOrEqual = ComparisonOf<CompareOp::LessOrEqual>;
+    using NotEqual = ComparisonOf<CompareOp::NotEqual>;
+    ASSERT_EQUAL(log(make_unique<Greater>(instance(), make_unique<NumericConst>(1))), "False __lt__\n"s);
+    ASSERT_EQUAL(log(make_unique<LessOrEqual>(instance(), make_unique<NumericConst>(1))), "True __lt__\n"s);
+    ASSERT_EQUAL(log(make_unique<NotEqual>(instance(), make_unique<NumericConst>(1))), "True __eq__\n"s);
+}
+
 }  // namespace
 
 void RunUnitTests(TestRunner& tr) {
@@ -476,6 +522,7 @@ void RunUnitTests(TestRunner& tr) {
     RUN_TEST(tr, ast::TestOr);
     RUN_TEST(tr, ast::TestAnd);
     RUN_TEST(tr, ast::TestNot);
+    RUN_TEST(tr, ast::TestComparisonOf);
 }
 
 }  // namespace ast
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "symbol.h"
+
+#include "arena.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <vector>
+
+using namespace std;
+
+namespace runtime {
+
+    namespace {
+        // Open-addressing index of entries by name --adding one allocates only when the slots grow
+        class EntryIndex {
+        public:
+            // Returns entry of name or nullptr, hash is std::hash of name
+            [[nodiscard]] const detail::SymbolEntry* Find(string_view name, size_t hash) const {
+                if (slots_.empty()) {
+                    return nullptr;
+                }
+                for (size_t i = hash & Mask();; i = (i + 1) & Mask()) {
+                    const Slot& slot = slots_[i];
+                    if (slot.entry == nullptr) {
+                        return nullptr;
+                    }
+                    if (slot.hash == hash && slot.entry->name == name) {
+                        return slot.entry;
+                    }
+                }
+            }
+
+            // Adds entry, which must not be in the index yet
+            void Insert(const detail::SymbolEntry* entry, size_t hash) {
+                if ((size_ + 1) * 2 > slots_.size()) { // at most half full, so probe runs stay short
+                    Grow();
+                }
+                Place({hash, entry});
+                ++size_;
+            }
+
+            [[nodiscard]] size_t Size() const {
+                return size_;
+            }
+
+        private:
+            struct Slot {
+                size_t hash = 0;
+                const detail::SymbolEntry* entry = nullptr; // nullptr marks a free slot
+            };
+
+            [[nodiscard]] size_t Mask() const {
+                return slots_.size() - 1;
+            }
+
+            void Place(Slot slot) {
+                size_t i = slot.hash & Mask();
+                while (slots_[i].entry != nullptr) {
+                    i = (i + 1) & Mask();
+                }
+                slots_[i] = slot;
+            }
+
+            void Grow() {
+                vector<Slot> old = std::move(slots_);
+                slots_.assign(std::max<size_t>(old.size() * 2, 64), Slot{});
+                for (const Slot& slot : old) {
+                    if (slot.entry != nullptr) {
+                        Place(slot);
+                    }
+                }
+            }
+
+            vector<Slot> slots_; // size is zero or a power of two
+            size_t size_ = 0;
+        };
+
+        // Names with their entries, ids are given in insertion order after the empty name's 0 --not synchronized
+        // Names and entries are bump-allocated in an arena, so storing a new name allocates only when a chunk
+        // or the index fills up
+        class NameStore {
+        public:
+            NameStore() {
+                Insert(&detail::EMPTY_SYMBOL, Hash(detail::EMPTY_SYMBOL.name));
+            }
+
+            static size_t Hash(string_view name) {
+                return std::hash<string_view>{}(name);
+            }
+
+            // Returns entry of name, stores name on first use
+            const detail::SymbolEntry* Intern(string_view name, size_t hash) {
+                if (const auto* entry = index_.Find(name, hash)) {
+                    return entry;
+                }
+                auto* chars = static_cast<char*>(storage_.Allocate(name.size(), 1)); // arena never moves them
+                std::copy(name.begin(), name.end(), chars);
+                const auto* entry = new (storage_.Allocate(sizeof(detail::SymbolEntry), alignof(detail::SymbolEntry)))
+                        detail::SymbolEntry{string_view(chars, name.size()), static_cast<uint32_t>(entries_.size())};
+                Insert(entry, hash);
+                return entry;
+            }
+
+            // Entries by id
+            [[nodiscard]] const vector<const detail::SymbolEntry*>& Entries() const {
+                return entries_;
+            }
+
+        private:
+            void Insert(const detail::SymbolEntry* entry, size_t hash) {
+                index_.Insert(entry, hash);
+                entries_.push_back(entry);
+            }
+
+            Arena storage_; // entries are trivially destructible, the arena frees them with the store
+            EntryIndex index_;
+            vector<const detail::SymbolEntry*> entries_;
+        };
+
+        // Process-wide name storage, shared by all lexers and parsers
+        // Lookups that only need the name never touch the table --Symbol keeps a view of it
+        class SymbolTable {
+        public:
+            static SymbolTable& Instance() {
+                static SymbolTable table;
+                return table;
+            }
+
+            // Returns entry of name, stores name on first use
+            const detail::SymbolEntry* Intern(string_view name) {
+                size_t hash = NameStore::Hash(name);
+                lock_guard guard(mutex_); // lexers may run on several threads
+                return names_.Intern(name, hash);
+            }
+
+            // Returns entries of all names in the same order, the lock is taken once
+            vector<const detail::SymbolEntry*> InternAll(const vector<const detail::SymbolEntry*>& names) {
+                vector<const detail::SymbolEntry*> result;
+                result.reserve(names.size());
+                lock_guard guard(mutex_);
+                for (const detail::SymbolEntry* name : names) {
+                    result.push_back(names_.Intern(name->name, NameStore::Hash(name->name)));
+                }
+                return result;
+            }
+
+            size_t Size() {
+                lock_guard guard(mutex_);
+                return names_.Entries().size();
+            }
+
+        private:
+            SymbolTable() = default;
+
+            mutex mutex_;
+            NameStore names_;
+        };
+    }  // namespace
+
+    Symbol::Symbol(std::string_view name): entry_(SymbolTable::Instance().Intern(name)) {}
+
+    Symbol::Symbol(const std::string& name): Symbol(string_view(name)) {}
+
+    Symbol::Symbol(const char* name): Symbol(string_view(name)) {}
+
+    std::ostream& operator<<(std::ostream& os, const Symbol& symbol) {
+        return os << symbol.Name();
+    }
+
+    size_t InternedSymbolCount() {
+        return SymbolTable::Instance().Size();
+    }
+
+    class LocalSymbolTable::Names : public NameStore {};
+
+    LocalSymbolTable::LocalSymbolTable(): names_(make_unique<Names>()) {}
+
+    LocalSymbolTable::~LocalSymbolTable() = default;
+
+    Symbol LocalSymbolTable::Intern(std::string_view name) {
+        return Symbol(names_->Intern(name, NameStore::Hash(name)));
+    }
+
+    std::vector<Symbol> LocalSymbolTable::Merge() const {
+        vector<Symbol> result;
+        result.reserve(names_->Entries().size());
+        for (const detail::SymbolEntry* entry : SymbolTable::Instance().InternAll(names_->Entries())) {
+            result.push_back(Symbol(entry));
+        }
+        return result;
+    }
+
+}  // namespace runtime
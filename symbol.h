@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace runtime {
+
+    namespace detail {
+        // Stored name and its id --lives in the symbol table until the program ends
+        struct SymbolEntry {
+            std::string_view name;
+            uint32_t id;
+        };
+
+        inline constexpr SymbolEntry EMPTY_SYMBOL{"", 0};
+    }  // namespace detail
+
+    // Interned name of a variable, field, method or class
+    // Equal names share one table entry, so comparison is a pointer compare and hashing an integer load
+    // Symbol is a single pointer to the entry --the name characters are owned by the global symbol table
+    class Symbol {
+    public:
+        // Creates the empty name --id 0 is reserved for it, so no table lookup is needed
+        constexpr Symbol() noexcept = default;
+
+        // Interns name --implicit, so string names can be passed wherever a Symbol is expected
+        Symbol(std::string_view name);  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        Symbol(const std::string& name);  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        Symbol(const char* name);  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+
+        // Returns interned name, valid for the program lifetime
+        [[nodiscard]] std::string_view Name() const {
+            return entry_->name;
+        }
+
+        // Returns id of the name in the symbol table
+        [[nodiscard]] uint32_t Id() const {
+            return entry_->id;
+        }
+
+        friend bool operator==(const Symbol& lhs, const Symbol& rhs) {
+            return lhs.entry_ == rhs.entry_;
+        }
+
+        friend bool operator!=(const Symbol& lhs, const Symbol& rhs) {
+            return lhs.entry_ != rhs.entry_;
+        }
+
+        // Orders by id, not by name --only for use as a map key
+        friend bool operator<(const Symbol& lhs, const Symbol& rhs) {
+            return lhs.Id() < rhs.Id();
+        }
+
+    private:
+        friend class LocalSymbolTable;
+
+        explicit Symbol(const detail::SymbolEntry* entry): entry_(entry) {}
+
+        const detail::SymbolEntry* entry_ = &detail::EMPTY_SYMBOL;
+    };
+
+    std::ostream& operator<<(std::ostream& os, const Symbol& symbol);
+
+    // Returns number of names interned so far
+    size_t InternedSymbolCount();
+
+    // Names of one worker thread kept apart from the process-wide table, which takes a lock per lookup
+    // Its symbols are local: ids count from 1 in this table and equal only symbols of the same table
+    // Merge maps them to process-wide symbols, taking the lock once for all names
+    class LocalSymbolTable {
+    public:
+        LocalSymbolTable();
+        ~LocalSymbolTable();
+
+        LocalSymbolTable(const LocalSymbolTable&) = delete;
+        LocalSymbolTable& operator=(const LocalSymbolTable&) = delete;
+
+        // Returns local symbol of name, stores name on first use --the empty name is the process-wide empty symbol
+        Symbol Intern(std::string_view name);
+
+        // Interns all names into the process-wide table, returns their symbols indexed by local id
+        [[nodiscard]] std::vector<Symbol> Merge() const;
+
+    private:
+        class Names;
+
+        std::unique_ptr<Names> names_;
+    };
+
+}  // namespace runtime
+
+template <>
+struct std::hash<runtime::Symbol> {
+    size_t operator()(const runtime::Symbol& symbol) const noexcept {
+        return symbol.Id();
+    }
+};
@@ -0,0 +1,234 @@
+#include "token_cache.h"
+
+#include <iterator>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+using namespace std;
+
+namespace parse {
+
+    namespace {
+        constexpr string_view MAGIC = "MYTK"sv;
+        constexpr uint64_t FORMAT_VERSION = 1; // bump when TokenTypes order or payloads change
+        constexpr size_t HASH_SIZE = 8;
+
+        template <typename T>
+        constexpr uint64_t KIND = TOKEN_KIND<T>;
+
+        void WriteVarint(string& out, uint64_t value) {
+            while (value >= 0x80) {
+                out.push_back(static_cast<char>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+
+        void WriteBytes(string& out, string_view bytes) {
+            WriteVarint(out, bytes.size());
+            out.append(bytes);
+        }
+
+        uint64_t ZigZag(int64_t value) {
+            return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+        }
+
+        int64_t UnZigZag(uint64_t value) {
+            return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+        }
+
+        // Builds tokens of kinds without payload by their index in TokenTypes
+        template <typename... Types>
+        constexpr array<void (*)(Token&), sizeof...(Types)> MakeEmplacers(TokenTypeList<Types...>) {
+            return {+[](Token& token) { token.emplace(Types{}); }...};
+        }
+
+        constexpr auto EMPLACERS = MakeEmplacers(TokenTypes{});
+
+        // Header without tables: magic, version, source hash
+        string MakeHeader(uint64_t source_hash) {
+            string header(MAGIC);
+            WriteVarint(header, FORMAT_VERSION);
+            for (size_t i = 0; i < HASH_SIZE; ++i) {
+                header.push_back(static_cast<char>(source_hash >> (8 * i)));
+            }
+            return header;
+        }
+    }  // namespace
+
+    uint64_t HashSource(std::string_view source) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (char c : source) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    void WriteTokenCache(std::string_view source, std::ostream& out) {
+        vector<string_view> names;
+        unordered_map<uint32_t, size_t> name_indexes; // by symbol id
+        vector<string_view> strings;
+        unordered_map<string_view, size_t> string_indexes; // by text, views into the lexer's pool
+        string body;
+
+        Lexer lexer(source);
+        for (const Token* token = &lexer.CurrentToken();; token = &lexer.NextToken()) {
+            WriteVarint(body, token->Kind());
+            if (const auto* number = token->TryAs<token_type::Number>()) {
+                WriteVarint(body, ZigZag(number->value));
+            } else if (const auto* id = token->TryAs<token_type::Id>()) {
+                auto [it, inserted] = name_indexes.emplace(id->value.Id(), names.size());
+                if (inserted) {
+                    names.push_back(id->value.Name());
+                }
+                WriteVarint(body, it->second);
+            } else if (const auto* str = token->TryAs<token_type::String>()) {
+                auto [it, inserted] = string_indexes.emplace(str->value.Text(), strings.size());
+                if (inserted) {
+                    strings.push_back(str->value.Text());
+                }
+                WriteVarint(body, it->second);
+            } else if (const auto* ch = token->TryAs<token_type::Char>()) {
+                body.push_back(ch->value);
+            } else if (token->Is<token_type::Eof>()) {
+                break;
+            }
+        }
+
+        string tables;
+        WriteVarint(tables, names.size());
+        for (string_view name : names) {
+            WriteBytes(tables, name);
+        }
+        WriteVarint(tables, strings.size());
+        for (string_view str : strings) {
+            WriteBytes(tables, str);
+        }
+        out << MakeHeader(HashSource(source)) << tables << body;
+    }
+
+    bool IsTokenCacheOf(std::string_view cache, std::string_view source) {
+        string header = MakeHeader(HashSource(source));
+        return cache.substr(0, header.size()) == header;
+    }
+
+    TokenStreamLexer::TokenStreamLexer(std::istream& cache)
+            : input_data_(istreambuf_iterator<char>(cache), istreambuf_iterator<char>()) {
+        Open(input_data_);
+    }
+
+    TokenStreamLexer::TokenStreamLexer(std::string_view cache) {
+        Open(cache);
+    }
+
+    TokenStreamLexer::TokenStreamLexer(MappedFile cache): file_(std::move(cache)) {
+        Open(file_->Data());
+    }
+
+    void TokenStreamLexer::Open(std::string_view cache) {
+        pos_ = cache.data();
+        end_ = cache.data() + cache.size();
+        if (ReadBytes(MAGIC.size()) != MAGIC) {
+            throw TokenCacheError("TokenStreamLexer(): not a token cache"s);
+        }
+        if (ReadVarint() != FORMAT_VERSION) {
+            throw TokenCacheError("TokenStreamLexer(): unsupported token cache version"s);
+        }
+        string_view hash = ReadBytes(HASH_SIZE);
+        for (size_t i = 0; i < HASH_SIZE; ++i) {
+            source_hash_ |= static_cast<uint64_t>(static_cast<unsigned char>(hash[i])) << (8 * i);
+        }
+        names_.resize(ReadCount());
+        for (auto& name : names_) {
+            name = runtime::Symbol(ReadBytes(ReadVarint()));
+        }
+        strings_.resize(ReadCount());
+        for (auto& str : strings_) {
+            str = string_pool_.Add(ReadBytes(ReadVarint()));
+        }
+        DecodeToken(window_[0]); // first token is ready after construction, same as with Lexer
+    }
+
+    uint64_t TokenStreamLexer::ReadVarint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos_ == end_) {
+                break;
+            }
+            auto byte = static_cast<unsigned char>(*pos_++);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw TokenCacheError("TokenStreamLexer(): truncated token cache"s);
+    }
+
+    uint64_t TokenStreamLexer::ReadCount() {
+        uint64_t count = ReadVarint();
+        if (count > static_cast<uint64_t>(end_ - pos_)) {
+            throw TokenCacheError("TokenStreamLexer(): table larger than the token cache"s);
+        }
+        return count;
+    }
+
+    std::string_view TokenStreamLexer::ReadBytes(size_t size) {
+        if (static_cast<size_t>(end_ - pos_) < size) {
+            throw TokenCacheError("TokenStreamLexer(): truncated token cache"s);
+        }
+        string_view bytes(pos_, size);
+        pos_ += size;
+        return bytes;
+    }
+
+    void TokenStreamLexer::DecodeToken(Token& token) {
+        uint64_t kind = ReadVarint();
+        if (kind == KIND<token_type::Number>) {
+            int64_t value = UnZigZag(ReadVarint());
+            if (value < numeric_limits<int>::min() || value > numeric_limits<int>::max()) {
+                throw TokenCacheError("TokenStreamLexer(): number out of range"s);
+            }
+            token.emplace(token_type::Number{static_cast<int>(value)});
+        } else if (kind == KIND<token_type::Id>) {
+            uint64_t index = ReadVarint();
+            if (index >= names_.size()) {
+                throw TokenCacheError("TokenStreamLexer(): name index out of range"s);
+            }
+            token.emplace(token_type::Id{names_[index]});
+        } else if (kind == KIND<token_type::String>) {
+            uint64_t index = ReadVarint();
+            if (index >= strings_.size()) {
+                throw TokenCacheError("TokenStreamLexer(): string index out of range"s);
+            }
+            token.emplace(token_type::String{strings_[index]});
+        } else if (kind == KIND<token_type::Char>) {
+            token.emplace(token_type::Char{ReadBytes(1)[0]});
+        } else if (kind < EMPLACERS.size()) {
+            EMPLACERS[kind](token);
+        } else {
+            throw TokenCacheError("TokenStreamLexer(): unknown token kind"s);
+        }
+    }
+
+    const Token& TokenStreamLexer::CurrentToken() const {
+        return window_[current_ % kTokenWindow];
+    }
+
+    const Token& TokenStreamLexer::NextToken() {
+        if (CurrentToken().Is<token_type::Eof>()) {
+            return CurrentToken();
+        }
+        Token& slot = window_[(current_ + 1) % kTokenWindow];
+        DecodeToken(slot);
+        ++current_;
+        return slot;
+    }
+
+    uint64_t TokenStreamLexer::SourceHash() const {
+        return source_hash_;
+    }
+
+}  // namespace parse
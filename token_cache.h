@@ -0,0 +1,77 @@
+#pragma once
+
+#include "lexer.h"
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace parse {
+
+    // Binary token cache --tokens of one source are scanned once and replayed later without lexing
+    // Layout, integers are LEB128 varints unless noted:
+    //   "MYTK" magic, format version, source hash as 8 little-endian bytes,
+    //   name count and names, string count and strings --each is byte length and bytes--,
+    //   tokens up to Eof: kind --index in TokenTypes-- and payload:
+    //   Number zigzag value, Id name index, String string index, Char one byte, nothing for the rest
+
+    // FNV-1a hash of source text, the cache is valid only for the source with the same hash
+    uint64_t HashSource(std::string_view source);
+
+    // Scans source with Lexer and writes its tokens in cache format, throws LexerError like Lexer
+    void WriteTokenCache(std::string_view source, std::ostream& out);
+
+    // Returns true if cache has the current format and was written for this source
+    bool IsTokenCacheOf(std::string_view cache, std::string_view source);
+
+    class TokenCacheError : public LexerError {
+    public:
+        using LexerError::LexerError;
+    };
+
+    // Replays a token cache through the same interface as Lexer, throws TokenCacheError on a damaged cache
+    class TokenStreamLexer : public TokenStream {
+    public:
+        // Reads the whole cache into an owned buffer
+        explicit TokenStreamLexer(std::istream& cache);
+
+        // Replays caller-owned cache --cache must outlive the lexer
+        explicit TokenStreamLexer(std::string_view cache);
+
+        // Replays memory-mapped cache file without copying it
+        explicit TokenStreamLexer(MappedFile cache);
+
+        TokenStreamLexer(const TokenStreamLexer&) = delete;
+        TokenStreamLexer& operator=(const TokenStreamLexer&) = delete;
+
+        [[nodiscard]] const Token& CurrentToken() const override;
+
+        const Token& NextToken() override;
+
+        // Hash of the source the cache was written for
+        [[nodiscard]] uint64_t SourceHash() const;
+
+    private:
+        void Open(std::string_view cache); // reads header and tables, decodes the first token
+        uint64_t ReadVarint();
+        uint64_t ReadCount(); // size of a table, each entry takes a byte at least --a larger one is damage
+        std::string_view ReadBytes(size_t size);
+        void DecodeToken(Token& token);
+
+        std::string input_data_; // owned cache if lexer was built from a stream
+        std::optional<MappedFile> file_; // owned cache if lexer was built from a file
+        const char* pos_ = nullptr; // next undecoded byte
+        const char* end_ = nullptr;
+        uint64_t source_hash_ = 0;
+        std::vector<runtime::Symbol> names_; // interned once per cache, not per token
+        StringPool string_pool_; // texts of String tokens, copied once per cache
+        std::vector<LiteralText> strings_;
+        std::array<Token, kTokenWindow> window_; // recently decoded tokens --keeps references valid like Lexer
+        size_t current_ = 0;
+    };
+
+}  // namespace parse